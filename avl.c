@@ -22,6 +22,7 @@
 
 #include <assert.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "smatch.h"
 #include "smatch_slist.h"
@@ -31,8 +32,8 @@ static void freeNode(AvlNode *node);
 
 static AvlNode *lookup(const struct stree *avl, AvlNode *node, const struct sm_state *sm);
 
-static bool insert_sm(struct stree *avl, AvlNode **p, const struct sm_state *sm);
-static bool remove_sm(struct stree *avl, AvlNode **p, const struct sm_state *sm, AvlNode **ret);
+static bool insert_sm(OwnerTree *tree, AvlNode **p, const struct sm_state *sm);
+static bool remove_sm(OwnerTree *tree, AvlNode **p, const struct sm_state *sm, AvlNode **ret);
 static bool removeExtremum(AvlNode **p, int side, AvlNode **ret);
 
 static int sway(AvlNode **p, int sway);
@@ -56,6 +57,65 @@ int unfree_stree;
 #define bal(side) ((side) == 0 ? -1 : 1)
 #define side(bal) ((bal)  == 1 ?  1 : 0)
 
+/*
+ * There is one slot per check.  Owners past num_checks (the "unnull_path"
+ * state uses -1) all go in the last slot.  cmp_tracker() sorts the higher
+ * owners first so a forward traversal walks the slots from the top down.
+ */
+static int nr_slots(void)
+{
+	return num_checks + 2;
+}
+
+static int owner_slot(int owner)
+{
+	if (owner > num_checks)
+		return num_checks + 1;
+	return owner;
+}
+
+struct owner_entry {
+	int slot;
+	OwnerTree *tree;
+};
+
+/* The index of the first entry with a slot >= "slot" */
+static int find_slot(const struct stree *avl, int slot)
+{
+	int lo = 0, hi = avl->nr_owners;
+
+	while (lo < hi) {
+		int mid = (lo + hi) / 2;
+
+		if (avl->owners[mid].slot < slot)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+static OwnerTree *slot_tree(const struct stree *avl, int slot)
+{
+	int i = find_slot(avl, slot);
+
+	if (i < avl->nr_owners && avl->owners[i].slot == slot)
+		return avl->owners[i].tree;
+	return NULL;
+}
+
+static int next_slot(const struct stree *avl, int slot, AvlDirection dir)
+{
+	int i;
+
+	if (dir == FORWARD) {
+		i = find_slot(avl, slot) - 1;
+		return i >= 0 ? avl->owners[i].slot : -1;
+	}
+	i = find_slot(avl, slot + 1);
+	return i < avl->nr_owners ? avl->owners[i].slot : -1;
+}
+
 static struct stree *avl_new(void)
 {
 	struct stree *avl = malloc(sizeof(*avl));
@@ -63,17 +123,112 @@ static struct stree *avl_new(void)
 	unfree_stree++;
 	assert(avl != NULL);
 
-	avl->root = NULL;
+	avl->owners = NULL;
+	avl->nr_owners = 0;
+	avl->max_owners = 0;
 	avl->base_stree = NULL;
-	avl->has_states = calloc(num_checks + 1, sizeof(char));
 	avl->count = 0;
 	avl->stree_id = 0;
 	avl->references = 1;
 	return avl;
 }
 
+static OwnerTree *new_owner_tree(void)
+{
+	OwnerTree *tree = malloc(sizeof(*tree));
+
+	assert(tree != NULL);
+
+	tree->root = NULL;
+	tree->count = 0;
+	tree->references = 1;
+	return tree;
+}
+
+static AvlNode *copyNode(AvlNode *node)
+{
+	AvlNode *new;
+
+	if (!node)
+		return NULL;
+
+	new = malloc(sizeof(*new));
+	assert(new != NULL);
+
+	new->sm = node->sm;
+	new->lr[0] = copyNode(node->lr[0]);
+	new->lr[1] = copyNode(node->lr[1]);
+	new->balance = node->balance;
+	return new;
+}
+
+static void put_owner_tree(OwnerTree *tree)
+{
+	assert(tree->references > 0);
+
+	if (--tree->references != 0)
+		return;
+	freeNode(tree->root);
+	free(tree);
+}
+
+static void set_owner_tree(struct stree *avl, int slot, OwnerTree *tree)
+{
+	int i = find_slot(avl, slot);
+
+	if (i < avl->nr_owners && avl->owners[i].slot == slot) {
+		if (tree) {
+			avl->owners[i].tree = tree;
+			return;
+		}
+		avl->nr_owners--;
+		memmove(&avl->owners[i], &avl->owners[i + 1],
+			(avl->nr_owners - i) * sizeof(*avl->owners));
+		return;
+	}
+	if (!tree)
+		return;
+	if (avl->nr_owners == avl->max_owners) {
+		avl->max_owners = avl->max_owners ? avl->max_owners * 2 : 4;
+		avl->owners = realloc(avl->owners, avl->max_owners * sizeof(*avl->owners));
+		assert(avl->owners != NULL);
+	}
+	memmove(&avl->owners[i + 1], &avl->owners[i],
+		(avl->nr_owners - i) * sizeof(*avl->owners));
+	avl->owners[i].slot = slot;
+	avl->owners[i].tree = tree;
+	avl->nr_owners++;
+}
+
+/*
+ * Returns an owner tree which can be modified without affecting any other
+ * stree.  The stree itself must already be unshared.
+ */
+static OwnerTree *get_writable_tree(struct stree *avl, int slot)
+{
+	OwnerTree *tree = slot_tree(avl, slot);
+	OwnerTree *new;
+
+	if (!tree) {
+		tree = new_owner_tree();
+		set_owner_tree(avl, slot, tree);
+		return tree;
+	}
+	if (tree->references == 1)
+		return tree;
+
+	new = new_owner_tree();
+	new->root = copyNode(tree->root);
+	new->count = tree->count;
+	tree->references--;
+	set_owner_tree(avl, slot, new);
+	return new;
+}
+
 void free_stree(struct stree **avl)
 {
+	int i;
+
 	if (!*avl)
 		return;
 
@@ -87,7 +242,9 @@ void free_stree(struct stree **avl)
 
 	unfree_stree--;
 
-	freeNode((*avl)->root);
+	for (i = 0; i < (*avl)->nr_owners; i++)
+		put_owner_tree((*avl)->owners[i].tree);
+	free((*avl)->owners);
 	free(*avl);
 	*avl = NULL;
 }
@@ -98,10 +255,7 @@ struct sm_state *avl_lookup(const struct stree *avl, const struct sm_state *sm)
 
 	if (!avl)
 		return NULL;
-	if (sm->owner != USHRT_MAX &&
-	    !avl->has_states[sm->owner])
-		return NULL;
-	found = lookup(avl, avl->root, sm);
+	found = avl_lookup_node(avl, sm);
 	if (!found)
 		return NULL;
 	return (struct sm_state *)found->sm;
@@ -109,7 +263,11 @@ struct sm_state *avl_lookup(const struct stree *avl, const struct sm_state *sm)
 
 AvlNode *avl_lookup_node(const struct stree *avl, const struct sm_state *sm)
 {
-	return lookup(avl, avl->root, sm);
+	OwnerTree *tree = slot_tree(avl, owner_slot(sm->owner));
+
+	if (!tree)
+		return NULL;
+	return lookup(avl, tree->root, sm);
 }
 
 size_t stree_count(const struct stree *avl)
@@ -122,56 +280,92 @@ size_t stree_count(const struct stree *avl)
 static struct stree *clone_stree_real(struct stree *orig)
 {
 	struct stree *new = avl_new();
-	AvlIter i;
+	int i;
 
-	avl_foreach(i, orig)
-		avl_insert(&new, i.sm);
+	if (orig->nr_owners) {
+		new->owners = malloc(orig->nr_owners * sizeof(*new->owners));
+		assert(new->owners != NULL);
+		memcpy(new->owners, orig->owners, orig->nr_owners * sizeof(*new->owners));
+		new->nr_owners = new->max_owners = orig->nr_owners;
+	}
+	for (i = 0; i < new->nr_owners; i++)
+		new->owners[i].tree->references++;
+	new->count = orig->count;
 
 	new->base_stree = orig->base_stree;
 	return new;
 }
 
-bool avl_insert(struct stree **avl, const struct sm_state *sm)
+static void unshare_stree(struct stree **avl)
 {
-	size_t old_count;
-
-	if (!*avl)
+	if (!*avl) {
 		*avl = avl_new();
+		return;
+	}
 	if ((*avl)->references > 1) {
 		(*avl)->references--;
 		*avl = clone_stree_real(*avl);
 	}
-	old_count = (*avl)->count;
-	/* fortunately we never call get_state() on "unnull_path" */
-	if (sm->owner != USHRT_MAX)
-		(*avl)->has_states[sm->owner] = 1;
-	insert_sm(*avl, &(*avl)->root, sm);
-	return (*avl)->count != old_count;
+}
+
+bool avl_insert(struct stree **avl, const struct sm_state *sm)
+{
+	OwnerTree *tree;
+	size_t old_count;
+
+	unshare_stree(avl);
+	tree = get_writable_tree(*avl, owner_slot(sm->owner));
+	old_count = tree->count;
+	insert_sm(tree, &tree->root, sm);
+	(*avl)->count += tree->count - old_count;
+	return tree->count != old_count;
 }
 
 bool avl_remove(struct stree **avl, const struct sm_state *sm)
 {
 	AvlNode *node = NULL;
+	OwnerTree *tree;
+	int slot;
 
 	if (!*avl)
 		return false;
+	slot = owner_slot(sm->owner);
+	if (!slot_tree(*avl, slot))
+		return false;
 	/* it's fairly rare for smatch to call avl_remove */
-	if ((*avl)->references > 1) {
-		(*avl)->references--;
-		*avl = clone_stree_real(*avl);
+	unshare_stree(avl);
+	tree = get_writable_tree(*avl, slot);
+
+	remove_sm(tree, &tree->root, sm, &node);
+
+	if (tree->count == 0) {
+		put_owner_tree(tree);
+		set_owner_tree(*avl, slot, NULL);
 	}
 
-	remove_sm(*avl, &(*avl)->root, sm, &node);
+	if (node == NULL)
+		return false;
 
+	free(node);
+	(*avl)->count--;
 	if ((*avl)->count == 0)
 		free_stree(avl);
+	return true;
+}
 
-	if (node == NULL) {
-		return false;
-	} else {
-		free(node);
-		return true;
+void avl_insert_owner(struct stree **avl, AvlIter *iter)
+{
+	OwnerTree *old;
+
+	unshare_stree(avl);
+	old = slot_tree(*avl, iter->slot);
+	if (old) {
+		(*avl)->count -= old->count;
+		put_owner_tree(old);
 	}
+	iter->tree->references++;
+	set_owner_tree(*avl, iter->slot, iter->tree);
+	(*avl)->count += iter->tree->count;
 }
 
 static AvlNode *mkNode(const struct sm_state *sm)
@@ -217,11 +411,11 @@ static AvlNode *lookup(const struct stree *avl, AvlNode *node, const struct sm_s
  *
  * Return true if the subtree's height increased.
  */
-static bool insert_sm(struct stree *avl, AvlNode **p, const struct sm_state *sm)
+static bool insert_sm(OwnerTree *tree, AvlNode **p, const struct sm_state *sm)
 {
 	if (*p == NULL) {
 		*p = mkNode(sm);
-		avl->count++;
+		tree->count++;
 		return true;
 	} else {
 		AvlNode *node = *p;
@@ -232,7 +426,7 @@ static bool insert_sm(struct stree *avl, AvlNode **p, const struct sm_state *sm)
 			return false;
 		}
 
-		if (!insert_sm(avl, &node->lr[side(cmp)], sm))
+		if (!insert_sm(tree, &node->lr[side(cmp)], sm))
 			return false;
 
 		/* If tree's balance became -1 or 1, it means the tree's height grew due to insertion. */
@@ -247,7 +441,7 @@ static bool insert_sm(struct stree *avl, AvlNode **p, const struct sm_state *sm)
  *
  * Return true if the subtree's height decreased.
  */
-static bool remove_sm(struct stree *avl, AvlNode **p, const struct sm_state *sm, AvlNode **ret)
+static bool remove_sm(OwnerTree *tree, AvlNode **p, const struct sm_state *sm, AvlNode **ret)
 {
 	if (p == NULL || *p == NULL) {
 		return false;
@@ -257,7 +451,7 @@ static bool remove_sm(struct stree *avl, AvlNode **p, const struct sm_state *sm,
 
 		if (cmp == 0) {
 			*ret = node;
-			avl->count--;
+			tree->count--;
 
 			if (node->lr[0] != NULL && node->lr[1] != NULL) {
 				AvlNode *replacement;
@@ -292,7 +486,7 @@ static bool remove_sm(struct stree *avl, AvlNode **p, const struct sm_state *sm,
 			return true;
 
 		} else {
-			if (!remove_sm(avl, &node->lr[side(cmp)], sm, ret))
+			if (!remove_sm(tree, &node->lr[side(cmp)], sm, ret))
 				return false;
 
 			/* If tree's balance became 0, it means the tree's height shrank due to removal. */
@@ -395,11 +589,23 @@ static void balance(AvlNode **p, int side)
 
 bool avl_check_invariants(struct stree *avl)
 {
+	OwnerTree *tree;
+	size_t count = 0;
 	int    dummy;
+	int i;
+
+	for (i = 0; i < avl->nr_owners; i++) {
+		if (i > 0 && avl->owners[i - 1].slot >= avl->owners[i].slot)
+			return false;
+		tree = avl->owners[i].tree;
+		if (!checkBalances(tree->root, &dummy))
+			return false;
+		if (!tree->count || countNode(tree->root) != tree->count)
+			return false;
+		count += tree->count;
+	}
 
-	return checkBalances(avl->root, &dummy)
-	    && checkOrder(avl)
-	    && countNode(avl->root) == avl->count;
+	return checkOrder(avl) && count == avl->count;
 }
 
 static bool checkBalances(AvlNode *node, int *height)
@@ -450,19 +656,23 @@ static size_t countNode(AvlNode *node)
 
 /************************* Traversal *************************/
 
-void avl_iter_begin(AvlIter *iter, struct stree *avl, AvlDirection dir)
+static void iter_begin_slot(AvlIter *iter, int slot)
 {
+	AvlDirection dir = iter->direction;
 	AvlNode *node;
 
 	iter->stack_index = 0;
-	iter->direction   = dir;
+	iter->slot = slot;
+	iter->at_start = true;
 
-	if (!avl || !avl->root) {
-		iter->sm      = NULL;
-		iter->node     = NULL;
+	if (slot < 0) {
+		iter->tree  = NULL;
+		iter->sm    = NULL;
+		iter->node  = NULL;
 		return;
 	}
-	node = avl->root;
+	iter->tree = slot_tree(iter->stree, slot);
+	node = iter->tree->root;
 
 	while (node->lr[dir] != NULL) {
 		iter->stack[iter->stack_index++] = node;
@@ -473,6 +683,43 @@ void avl_iter_begin(AvlIter *iter, struct stree *avl, AvlDirection dir)
 	iter->node  = node;
 }
 
+void avl_iter_begin(AvlIter *iter, struct stree *avl, AvlDirection dir)
+{
+	iter->stree = avl;
+	iter->direction = dir;
+	iter->one_owner = false;
+
+	if (!avl) {
+		iter_begin_slot(iter, -1);
+		return;
+	}
+	iter_begin_slot(iter, next_slot(avl, dir == FORWARD ? nr_slots() : -1, dir));
+}
+
+void avl_iter_begin_owner(AvlIter *iter, struct stree *avl, int owner)
+{
+	int slot = owner_slot(owner);
+
+	iter->stree = avl;
+	iter->direction = FORWARD;
+	iter->one_owner = true;
+
+	if (!avl || !slot_tree(avl, slot))
+		slot = -1;
+	iter_begin_slot(iter, slot);
+}
+
+void avl_iter_next_owner(AvlIter *iter)
+{
+	if (iter->node == NULL)
+		return;
+
+	if (iter->one_owner)
+		iter_begin_slot(iter, -1);
+	else
+		iter_begin_slot(iter, next_slot(iter->stree, iter->slot, iter->direction));
+}
+
 void avl_iter_next(AvlIter *iter)
 {
 	AvlNode     *node = iter->node;
@@ -481,6 +728,8 @@ void avl_iter_next(AvlIter *iter)
 	if (node == NULL)
 		return;
 
+	iter->at_start = false;
+
 	node = node->lr[1 - dir];
 	if (node != NULL) {
 		while (node->lr[dir] != NULL) {
@@ -490,8 +739,7 @@ void avl_iter_next(AvlIter *iter)
 	} else if (iter->stack_index > 0) {
 		node = iter->stack[--iter->stack_index];
 	} else {
-		iter->sm      = NULL;
-		iter->node     = NULL;
+		avl_iter_next_owner(iter);
 		return;
 	}
 
@@ -499,6 +747,12 @@ void avl_iter_next(AvlIter *iter)
 	iter->sm   = (struct sm_state *) node->sm;
 }
 
+bool avl_iter_shared_owner(AvlIter *one, AvlIter *two)
+{
+	return one->node && one->at_start && two->at_start &&
+	       one->tree == two->tree;
+}
+
 struct stree *clone_stree(struct stree *orig)
 {
 	if (!orig)
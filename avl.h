@@ -30,11 +30,20 @@ struct sm_state;
 
 typedef struct AvlNode       AvlNode;
 typedef struct AvlIter       AvlIter;
+typedef struct OwnerTree     OwnerTree;
 
+struct owner_entry;
+
+/*
+ * The states are partitioned by owner.  Each check gets its own AVL tree
+ * and the trees are reference counted so strees which are copies of each
+ * other share the subtrees for the owners which haven't changed.  Only
+ * the owners which have states get an entry, sorted by slot.
+ */
 struct stree {
-	AvlNode    *root;
+	struct owner_entry *owners;
+	int nr_owners, max_owners;
 	struct stree *base_stree;
-	char *has_states;
 	size_t      count;
 	int stree_id;
 	int references;
@@ -91,9 +100,15 @@ bool avl_check_invariants(struct stree *avl);
 
 #define END_FOR_EACH_SM(_sm) }}
 
+#define avl_foreach_owner(iter, avl, owner)			\
+	for (avl_iter_begin_owner(&(iter), avl, owner);		\
+	     (iter).node != NULL;				\
+	     avl_iter_next(&iter))
+	/* O(k). Traverse only the states which belong to owner. */
+
 #define FOR_EACH_MY_SM(_owner, avl, _sm) {	\
 	AvlIter _i;				\
-	avl_foreach(_i, avl) {			\
+	avl_foreach_owner(_i, avl, _owner) {	\
 		_sm = _i.sm;			\
 		if (_sm->owner != _owner)	\
 			continue;		\
@@ -108,13 +123,30 @@ struct AvlIter {
 	AvlNode      *node;
 
 	/* private */
+	struct stree *stree;
+	OwnerTree    *tree;
+	int           slot;
+	bool          one_owner;
+	bool          at_start;
 	AvlNode      *stack[100];
 	int           stack_index;
 	AvlDirection  direction;
 };
 
 void avl_iter_begin(AvlIter *iter, struct stree *avl, AvlDirection dir);
+void avl_iter_begin_owner(AvlIter *iter, struct stree *avl, int owner);
 void avl_iter_next(AvlIter *iter);
+void avl_iter_next_owner(AvlIter *iter);
+	/* Skip the rest of the states for the current owner. */
+
+bool avl_iter_shared_owner(AvlIter *one, AvlIter *two);
+	/*
+	 * True if both iterators are at the start of the same owner subtree.
+	 * In other words, every state for that owner is identical.
+	 */
+
+void avl_insert_owner(struct stree **avl, AvlIter *iter);
+	/* O(1). Share the owner subtree iter is in with avl. */
 #define avl_traverse(iter, avl, direction)        \
 	for (avl_iter_begin(&(iter), avl, direction); \
 	     (iter).node != NULL;                     \
@@ -130,6 +162,12 @@ struct AvlNode {
 	int         balance; /* -1, 0, or 1 */
 };
 
+struct OwnerTree {
+	AvlNode    *root;
+	size_t      count;
+	int references;
+};
+
 AvlNode *avl_lookup_node(const struct stree *avl, const struct sm_state *sm);
 	/* O(log n). Lookup an stree node by sm.  Return NULL if not present. */
 
@@ -157,10 +157,10 @@ void check_bit_shift(int id)
 	register_shifters();
 
 	add_hook(&match_assign, ASSIGNMENT_HOOK);
-	add_hook(&match_binop, BINOP_HOOK);
+	add_op_hook(&match_binop, BINOP_HOOK, '&');
 
 	if (option_info) {
-		add_hook(&match_binop_info, BINOP_HOOK);
+		add_op_hook(&match_binop_info, BINOP_HOOK, SPECIAL_LEFTSHIFT);
 		if (option_project == PROJ_KERNEL) {
 			add_function_hook("set_bit", &match_call, INT_PTR(0));
 			add_function_hook("test_bit", &match_call, INT_PTR(0));
@@ -61,6 +61,10 @@ void check_container_of(int id)
 		return;
 
 	my_id = id;
+	add_check_trigger(my_id, "container_of");
+	add_check_trigger(my_id, "list_first_entry");
+	add_check_trigger(my_id, "nla_data");
+
 	add_macro_assign_hook("container_of", &match_non_null, NULL);
 	add_macro_assign_hook("list_first_entry", &match_non_null, NULL);
 	add_function_assign_hook("nla_data", &match_non_null, NULL);
@@ -285,7 +285,8 @@ void check_deref(int id)
 	add_unmatched_state_hook(my_id, &unmatched_state);
 	add_modification_hook(my_id, &is_ok);
 	add_hook(&match_dereferences, DEREF_HOOK);
-	add_hook(&match_pointer_as_array, OP_HOOK);
+	add_op_hook(&match_pointer_as_array, OP_HOOK, '*');
+	add_op_hook(&match_pointer_as_array, OP_HOOK, '(');
 	select_return_implies_hook(DEREFERENCE, &set_param_dereferenced);
 	add_hook(&match_condition, CONDITION_HOOK);
 	add_hook(&match_declarations, DECLARATION_HOOK);
@@ -124,7 +124,8 @@ void check_dereferences_param(int id)
 	add_hook(&match_function_def, FUNC_DEF_HOOK);
 
 	add_hook(&match_dereference, DEREF_HOOK);
-	add_hook(&match_pointer_as_array, OP_HOOK);
+	add_op_hook(&match_pointer_as_array, OP_HOOK, '*');
+	add_op_hook(&match_pointer_as_array, OP_HOOK, '(');
 	select_return_implies_hook(DEREFERENCE, &set_param_dereferenced);
 	add_modification_hook(my_id, &set_ignore);
 
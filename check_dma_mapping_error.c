@@ -70,6 +70,9 @@ void check_dma_mapping_error(int id)
 		return;
 
 	my_id = id;
+	add_check_trigger(my_id, "dma_mapping_error");
+	add_check_trigger(my_id, "pci_dma_mapping_error");
+
 	add_function_assign_hook("dma_mapping_error", &match_assign, NULL);
 	add_function_assign_hook("pci_dma_mapping_error", &match_assign, NULL);
 	add_hook(&match_condition, CONDITION_HOOK);
@@ -305,5 +305,6 @@ void check_implicit_dependencies(int id)
 
 	/* hooks to track written fields */
 	add_hook(&match_assign_value, ASSIGNMENT_HOOK_AFTER);
-	add_hook(&unop_expr, OP_HOOK);
+	add_op_hook(&unop_expr, OP_HOOK, SPECIAL_INCREMENT);
+	add_op_hook(&unop_expr, OP_HOOK, SPECIAL_DECREMENT);
 }
@@ -332,7 +332,8 @@ static void array_check(struct expression *expr)
 
 void check_index_overflow(int id)
 {
-	add_hook(&array_check, OP_HOOK);
+	add_op_hook(&array_check, OP_HOOK, '*');
+	add_op_hook(&array_check, OP_HOOK, '(');
 }
 
 static void match_condition(struct expression *expr)
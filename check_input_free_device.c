@@ -63,6 +63,8 @@ void check_input_free_device(int id)
 	my_id = id;
 	if (option_project != PROJ_KERNEL)
 		return;
+	add_check_trigger(my_id, "input_unregister_device");
+
 	add_hook(&match_assign, ASSIGNMENT_HOOK);
 	add_function_hook("input_unregister_device", &match_input_unregister, NULL);
 	add_function_hook("input_free_device", &match_input_free, NULL);
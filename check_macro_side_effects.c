@@ -160,7 +160,8 @@ void check_macro_side_effects(int id)
 	if (!option_spammy)
 		return;
 
-	add_hook(&match_unop, OP_HOOK);
+	add_op_hook(&match_unop, OP_HOOK, SPECIAL_INCREMENT);
+	add_op_hook(&match_unop, OP_HOOK, SPECIAL_DECREMENT);
 	add_hook(&match_stmt, STMT_HOOK);
 	register_ignored_macros();
 }
@@ -151,7 +151,9 @@ void check_off_by_one_relative(int id)
 {
 	my_id = id;
 
-	add_hook(&array_check, OP_HOOK);
-	add_hook(&array_check_data_info, OP_HOOK);
+	add_op_hook(&array_check, OP_HOOK, '*');
+	add_op_hook(&array_check, OP_HOOK, '(');
+	add_op_hook(&array_check_data_info, OP_HOOK, '*');
+	add_op_hook(&array_check_data_info, OP_HOOK, '(');
 }
 
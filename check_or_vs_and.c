@@ -188,5 +188,5 @@ void check_or_vs_and(int id)
 	add_hook(&match_logic, LOGIC_HOOK);
 	add_hook(&match_condition, CONDITION_HOOK);
 	if (option_spammy)
-		add_hook(&match_binop, BINOP_HOOK);
+		add_op_hook(&match_binop, BINOP_HOOK, '&');
 }
@@ -130,7 +130,7 @@ static void check_assign(struct expression *expr)
 void check_pointer_math(int id)
 {
 	my_id = id;
-	add_hook(&match_binop, BINOP_HOOK);
+	add_op_hook(&match_binop, BINOP_HOOK, '+');
 	add_hook(&match_assign, ASSIGNMENT_HOOK);
 	add_hook(&check_assign, ASSIGNMENT_HOOK);
 	add_modification_hook(my_id, &set_undefined);
@@ -136,7 +136,7 @@ void check_precedence(int id)
 	my_id = id;
 
 	add_hook(&match_condition, CONDITION_HOOK);
-	add_hook(&match_binop, BINOP_HOOK);
-	add_hook(&match_mask, BINOP_HOOK);
-	add_hook(&match_subtract_shift, BINOP_HOOK);
+	add_op_hook(&match_binop, BINOP_HOOK, '&');
+	add_op_hook(&match_mask, BINOP_HOOK, '&');
+	add_op_hook(&match_subtract_shift, BINOP_HOOK, SPECIAL_LEFTSHIFT);
 }
@@ -82,6 +82,9 @@ void check_release_resource(int id)
 	if (option_project != PROJ_KERNEL)
 		return;
 
+	add_check_trigger(my_id, "request_resource");
+	add_check_trigger(my_id, "request_mem_resource");
+
 	add_function_hook("request_resource", &match_request, (void *)1);
 	add_function_hook("release_resource", &match_release, (void *)0);
 	add_function_hook("request_mem_resource", &match_request, (void *)0);
@@ -87,8 +87,8 @@ void check_shift_to_zero(int id)
 {
 	my_id = id;
 
-	add_hook(&match_binop, BINOP_HOOK);
-	add_hook(&match_binop2, BINOP_HOOK);
+	add_op_hook(&match_binop, BINOP_HOOK, SPECIAL_RIGHTSHIFT);
+	add_op_hook(&match_binop2, BINOP_HOOK, SPECIAL_RIGHTSHIFT);
 
 	add_hook(&match_assign, ASSIGNMENT_HOOK);
 
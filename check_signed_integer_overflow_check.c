@@ -106,6 +106,6 @@ void check_signed_integer_overflow_check(int id)
 	}
 
 	add_hook(&match_condition, CONDITION_HOOK);
-	add_hook(&match_binop, BINOP_HOOK);
+	add_op_hook(&match_binop, BINOP_HOOK, '-');
 }
 
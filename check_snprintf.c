@@ -79,6 +79,8 @@ void check_snprintf(int id)
 		return;
 
 	my_id = id;
+	add_check_trigger(my_id, "snprintf");
+
 	add_hook(&match_call, FUNCTION_CALL_HOOK);
 	add_function_assign_hook("snprintf", &match_snprintf, NULL);
 	add_modification_hook(my_id, &ok_to_use);
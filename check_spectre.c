@@ -206,5 +206,6 @@ void check_spectre(int id)
 	if (option_project != PROJ_KERNEL)
 		return;
 
-	add_hook(&array_check, OP_HOOK);
+	add_op_hook(&array_check, OP_HOOK, '*');
+	add_op_hook(&array_check, OP_HOOK, '(');
 }
@@ -121,7 +121,8 @@ static void match_condition(struct expression *expr)
 void check_testing_index_after_use(int id)
 {
 	my_used_id = id;
-	add_hook(&array_check, OP_HOOK);
+	add_op_hook(&array_check, OP_HOOK, '*');
+	add_op_hook(&array_check, OP_HOOK, '(');
 	add_hook(&match_condition, CONDITION_HOOK);
 	add_modification_hook(my_used_id, &delete);
 }
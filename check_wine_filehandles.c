@@ -88,6 +88,7 @@ void check_wine_filehandles(int id)
 
 	my_id = id;
 	for (i = 0; filehandle_funcs[i]; i++) {
+		add_check_trigger(my_id, filehandle_funcs[i]);
 		add_function_assign_hook(filehandle_funcs[i],
 					 &match_returns_handle, NULL);
 	}
@@ -17,8 +17,24 @@
 #include "linearize.h"
 #include "flow.h"
 
-#define INSN_HASH_SIZE 256
-static struct instruction_list *insn_hash_table[INSN_HASH_SIZE];
+/*
+ * Value numbering: the dominator tree is walked in preorder and every
+ * instruction is looked up in a table holding the instructions of the
+ * blocks dominating it.  One that is already there is replaced by it,
+ * otherwise it goes in, and it comes out again when the walk leaves its
+ * block.  The value number of an instruction is simply its target pseudo,
+ * which stays the same from one pass to the next.
+ *
+ * That walk is only done when the CFG changed since the last one, which
+ * is also when the dominator tree has to be built again.  Otherwise the
+ * same table holds every instruction of the function and only the ones
+ * simplify queued are looked up in it, see cse_worklist_insns().
+ */
+#define INSN_HASH_BITS 8
+static struct instruction_list **insn_hash_table;
+static unsigned int insn_hash_bits;
+static long *scope;
+static int scope_nr, scope_max;
 
 int repeat_phase;
 
@@ -35,16 +51,75 @@ static int phi_compare(pseudo_t phi1, pseudo_t phi2)
 }
 
 
-static void clean_up_one_instruction(struct basic_block *bb, struct instruction *insn)
+/*
+ * Once the first pass over the function is done, only the instructions
+ * whose operands, users or definitions changed can simplify or CSE any
+ * further, so those are queued here and revisited instead of rescanning
+ * the whole function.  The blocks whose parents or children changed are
+ * queued as a whole, and the memops are redone only for the blocks with
+ * a load or store that was looked at again.  The worklists live from
+ * start_cleanup() to end_cleanup(), across the whole linearize_fn()
+ * pipeline, so the CFG passes between two rounds of CSE feed them too.
+ */
+static struct instruction_list *insn_worklist, *cse_worklist;
+static struct basic_block_list *bb_worklist, *memops_worklist;
+static struct entrypoint *worklist_ep;
+static int need_full_pass, need_memops;
+
+/*
+ * The dominator tree of the last full walk, and when the walk entered
+ * and left each block (by postorder number): a block dominates another
+ * one if it was entered before and left after it.
+ */
+static unsigned long cse_generation;
+static int *dom_enter, *dom_leave, dom_nr;
+static int value_table_filled;
+static unsigned long cse_insn_nr;
+
+void queue_insn(struct instruction *insn)
 {
-	unsigned long hash;
+	if (worklist_ep && insn && insn->bb)
+		add_instruction(&insn_worklist, insn);
+}
 
-	if (!insn->bb)
-		return;
-	assert(insn->bb == bb);
-	repeat_phase |= simplify_instruction(insn);
-	if (!insn->bb)
+void queue_bb(struct basic_block *bb)
+{
+	if (worklist_ep && bb && bb->ep)
+		add_bb(&bb_worklist, bb);
+}
+
+static void queue_users(pseudo_t pseudo)
+{
+	struct pseudo_user *pu;
+
+	if (!has_use_list(pseudo))
 		return;
+	FOR_EACH_PTR(pseudo->users, pu) {
+		if (*pu->userp != VOID)
+			queue_insn(pu->insn);
+	} END_FOR_EACH_PTR(pu);
+}
+
+static int has_target(struct instruction *insn)
+{
+	switch (insn->opcode) {
+	case OP_BINARY ... OP_BINCMP_END:
+	case OP_SEL: case OP_RANGE:
+	case OP_NOT: case OP_NEG:
+	case OP_CAST: case OP_SCAST:
+	case OP_FPCAST: case OP_PTRCAST:
+	case OP_PHI: case OP_PHISOURCE:
+	case OP_LOAD: case OP_SYMADDR:
+	case OP_SETVAL: case OP_SLICE:
+		return 1;
+	}
+	return 0;
+}
+
+static long insn_hash(struct instruction *insn)
+{
+	unsigned long hash;
+
 	hash = (insn->opcode << 3) + (insn->size >> 3);
 	switch (insn->opcode) {
 	case OP_SEL:
@@ -118,11 +193,50 @@ static void clean_up_one_instruction(struct basic_block *bb, struct instruction
 		 * Nothing to do, don't even bother hashing them,
 		 * we're not going to try to CSE them
 		 */
+		return -1;
+	}
+	/* keep it commutative up to here, the operands were just added up */
+	return ((unsigned long long)hash * 0x9e3779b97f4a7c15ULL) >> (64 - insn_hash_bits);
+}
+
+/*
+ * A store can make the loads of the same address elsewhere redundant,
+ * so their blocks go on the list too.
+ */
+static void queue_memop(struct instruction *insn)
+{
+	struct pseudo_user *pu;
+
+	add_bb(&memops_worklist, insn->bb);
+	if (insn->opcode != OP_STORE || !has_use_list(insn->src))
 		return;
+	FOR_EACH_PTR(insn->src->users, pu) {
+		struct instruction *load = pu->insn;
+
+		if (load->bb && load->bb != insn->bb && load->opcode == OP_LOAD)
+			add_bb(&memops_worklist, load->bb);
+	} END_FOR_EACH_PTR(pu);
+}
+
+static void clean_up_one_instruction(struct basic_block *bb, struct instruction *insn, int queued)
+{
+	int changed;
+
+	if (!insn->bb)
+		return;
+	assert(insn->bb == bb);
+	changed = simplify_instruction(insn);
+	repeat_phase |= changed;
+	if (changed && insn->bb) {
+		queue_insn(insn);
+		if (has_target(insn))
+			queue_users(insn->target);
 	}
-	hash += hash >> 16;
-	hash &= INSN_HASH_SIZE-1;
-	add_instruction(insn_hash_table + hash, insn);
+	if (!insn->bb || !(changed || queued))
+		return;
+	add_instruction(&cse_worklist, insn);
+	if (insn->opcode == OP_LOAD || insn->opcode == OP_STORE)
+		queue_memop(insn);
 }
 
 static void clean_up_insns(struct entrypoint *ep)
@@ -132,9 +246,36 @@ static void clean_up_insns(struct entrypoint *ep)
 	FOR_EACH_PTR(ep->bbs, bb) {
 		struct instruction *insn;
 		FOR_EACH_PTR(bb->insns, insn) {
-			clean_up_one_instruction(bb, insn);
+			clean_up_one_instruction(bb, insn, 0);
+		} END_FOR_EACH_PTR(insn);
+	} END_FOR_EACH_PTR(bb);
+}
+
+static void clean_up_worklist(void)
+{
+	struct instruction_list *list = insn_worklist;
+	struct basic_block_list *blocks = bb_worklist;
+	unsigned long generation = ++bb_generation;
+	struct instruction *insn;
+	struct basic_block *bb;
+
+	insn_worklist = NULL;
+	bb_worklist = NULL;
+	FOR_EACH_PTR(blocks, bb) {
+		if (!bb->ep || bb->generation == generation)
+			continue;
+		bb->generation = generation;
+		FOR_EACH_PTR(bb->insns, insn) {
+			clean_up_one_instruction(bb, insn, 1);
 		} END_FOR_EACH_PTR(insn);
 	} END_FOR_EACH_PTR(bb);
+	free_ptr_list(&blocks);
+
+	FOR_EACH_PTR(list, insn) {
+		if (insn->bb)
+			clean_up_one_instruction(insn->bb, insn, 1);
+	} END_FOR_EACH_PTR(insn);
+	free_ptr_list((struct ptr_list **)&list);
 }
 
 /* Compare two (sorted) phi-lists */
@@ -250,11 +391,6 @@ static int insn_compare(const void *_i1, const void *_i2)
 	return 0;
 }
 
-static void sort_instruction_list(struct instruction_list **list)
-{
-	sort_list((struct ptr_list **)list , insn_compare);
-}
-
 static struct instruction * cse_one_instruction(struct instruction *insn, struct instruction *def)
 {
 	convert_instruction_target(insn, def->target);
@@ -264,40 +400,113 @@ static struct instruction * cse_one_instruction(struct instruction *insn, struct
 	return def;
 }
 
+static void alloc_insn_hash(unsigned int bits)
+{
+	insn_hash_bits = bits;
+	insn_hash_table = calloc(1U << bits, sizeof(*insn_hash_table));
+	if (!insn_hash_table)
+		die("out of memory for the CSE hash table");
+}
+
+static void clear_insn_hash(void)
+{
+	unsigned int i;
+
+	value_table_filled = 0;
+	if (!insn_hash_table)
+		return;
+	for (i = 0; i < 1U << insn_hash_bits; i++)
+		free_ptr_list((struct ptr_list **)insn_hash_table + i);
+}
+
+static void free_insn_hash(void)
+{
+	if (!insn_hash_table)
+		return;
+	clear_insn_hash();
+	free(insn_hash_table);
+	insn_hash_table = NULL;
+	insn_hash_bits = 0;
+	free(scope);
+	scope = NULL;
+	scope_max = 0;
+}
+
+/* The table is empty between walks, so growing it is just a new one */
+static void size_insn_hash(struct entrypoint *ep)
+{
+	unsigned int bits = INSN_HASH_BITS;
+	struct basic_block *bb;
+	unsigned long nr = 0;
+
+	FOR_EACH_PTR(ep->bbs, bb) {
+		nr += instruction_list_size(bb->insns);
+	} END_FOR_EACH_PTR(bb);
+	cse_insn_nr = nr;
+	while (bits < 24 && (2UL << bits) < nr)
+		bits++;
+	if (bits <= insn_hash_bits)
+		return;
+	free_insn_hash();
+	alloc_insn_hash(bits);
+}
+
+static struct instruction *lookup_insn_hash(struct instruction *insn, long hash)
+{
+	struct instruction *def;
+
+	FOR_EACH_PTR_REVERSE(insn_hash_table[hash], def) {
+		if (def->bb && !insn_compare(def, insn))
+			return def;
+	} END_FOR_EACH_PTR_REVERSE(def);
+	return NULL;
+}
+
+static void scope_push(long hash)
+{
+	if (scope_nr >= scope_max) {
+		scope_max = scope_max ? scope_max * 2 : 256;
+		scope = realloc(scope, scope_max * sizeof(*scope));
+		if (!scope)
+			die("out of memory for the CSE scopes");
+	}
+	scope[scope_nr++] = hash;
+}
+
 /*
- * Does "bb1" dominate "bb2"?
+ * Number the instructions of one block.  The hash of every instruction
+ * entered in the table is pushed on the scope stack so that they can be
+ * taken out again, last in first out, when the walk leaves the block.
  */
-static int bb_dominates(struct entrypoint *ep, struct basic_block *bb1, struct basic_block *bb2, unsigned long generation)
+static void cse_one_bb(struct basic_block *bb)
 {
-	struct basic_block *parent;
+	struct instruction *insn, *def;
 
-	/* Nothing dominates the entrypoint.. */
-	if (bb2 == ep->entry->bb)
-		return 0;
-	FOR_EACH_PTR(bb2->parents, parent) {
-		if (parent == bb1)
+	FOR_EACH_PTR(bb->insns, insn) {
+		long hash;
+
+		if (!insn->bb)
 			continue;
-		if (parent->generation == generation)
+		hash = insn_hash(insn);
+		if (hash < 0)
 			continue;
-		parent->generation = generation;
-		if (!bb_dominates(ep, bb1, parent, generation))
-			return 0;
-	} END_FOR_EACH_PTR(parent);
-	return 1;
+		def = lookup_insn_hash(insn, hash);
+		if (def) {
+			cse_one_instruction(insn, def);
+			continue;
+		}
+		add_instruction(insn_hash_table + hash, insn);
+		scope_push(hash);
+	} END_FOR_EACH_PTR(insn);
 }
 
-static struct basic_block *trivial_common_parent(struct basic_block *bb1, struct basic_block *bb2)
+static void leave_scope(int depth)
 {
-	struct basic_block *parent;
+	while (scope_nr > depth) {
+		long hash = scope[--scope_nr];
 
-	if (bb_list_size(bb1->parents) != 1)
-		return NULL;
-	parent = first_basic_block(bb1->parents);
-	if (bb_list_size(bb2->parents) != 1)
-		return NULL;
-	if (first_basic_block(bb2->parents) != parent)
-		return NULL;
-	return parent;
+		undo_ptr_list_last((struct ptr_list **)insn_hash_table + hash);
+	}
 }
 
 static inline void remove_instruction(struct instruction_list **list, struct instruction *insn, int count)
@@ -313,85 +522,301 @@ static void add_instruction_to_end(struct instruction *insn, struct basic_block
 	add_instruction(&bb->insns, br);
 }
 
-static struct instruction * try_to_cse(struct entrypoint *ep, struct instruction *i1, struct instruction *i2)
+/*
+ * The same instruction in two blocks whose only parent is "bb" doesn't
+ * have a dominating copy, but can be moved up to the end of "bb".  The
+ * children are entered in the table for this only, on top of the blocks
+ * dominating them, and taken out again before the walk goes on.
+ */
+static void hoist_common_insns(struct basic_block *bb)
 {
-	struct basic_block *b1, *b2, *common;
+	unsigned long siblings = ++bb_generation;
+	unsigned long done = ++bb_generation;
+	struct basic_block *child;
+	int depth = scope_nr;
 
-	/*
-	 * OK, i1 and i2 are the same instruction, modulo "target".
-	 * We should now see if we can combine them.
-	 */
-	b1 = i1->bb;
-	b2 = i2->bb;
+	FOR_EACH_PTR(bb->children, child) {
+		if (child && child != bb && bb_list_size(child->parents) == 1)
+			child->generation = siblings;
+	} END_FOR_EACH_PTR(child);
 
-	/*
-	 * Currently we only handle the uninteresting degenerate case where
-	 * the CSE is inside one basic-block.
-	 */
-	if (b1 == b2) {
-		struct instruction *insn;
-		FOR_EACH_PTR(b1->insns, insn) {
-			if (insn == i1)
-				return cse_one_instruction(i2, i1);
-			if (insn == i2)
-				return cse_one_instruction(i1, i2);
+	FOR_EACH_PTR(bb->children, child) {
+		struct instruction *insn, *def;
+
+		/* the same child can be there more than once */
+		if (!child || child->generation != siblings)
+			continue;
+		child->generation = done;
+		FOR_EACH_PTR(child->insns, insn) {
+			struct basic_block *from;
+			long hash;
+
+			if (!insn->bb || insn->opcode == OP_PHI)
+				continue;
+			hash = insn_hash(insn);
+			if (hash < 0)
+				continue;
+			def = lookup_insn_hash(insn, hash);
+			if (!def) {
+				add_instruction(insn_hash_table + hash, insn);
+				scope_push(hash);
+				continue;
+			}
+			/* one dominating it is left for the walk */
+			from = def->bb;
+			if (from == child || from->generation != done)
+				continue;
+			cse_one_instruction(insn, def);
+			remove_instruction(&from->insns, def, 1);
+			add_instruction_to_end(def, bb);
+			/* it may have a dominating copy now */
+			add_instruction(&cse_worklist, def);
 		} END_FOR_EACH_PTR(insn);
-		warning(b1->pos, "Whaa? unable to find CSE instructions");
-		return i1;
+	} END_FOR_EACH_PTR(child);
+	leave_scope(depth);
+}
+
+/*
+ * The walk is iterative: the dominator tree is kept as first-child and
+ * next-sibling links, indexed by the postorder number of the blocks.
+ * A negative entry on the stack means leaving that block.
+ */
+static void cse_dominator_walk(struct entrypoint *ep)
+{
+	struct basic_block *entry = ep->entry->bb;
+	struct basic_block **bbs, *bb;
+	int *child, *sibling, *stack, *depth;
+	int nr, top = 0, clock = 0, i;
+
+	if (!ep->dom_generation)
+		build_dominator_tree(ep);
+	cse_generation = ep->dom_generation;
+	clear_insn_hash();
+	size_insn_hash(ep);
+	nr = entry->postorder + 1;
+	bbs = calloc(nr, sizeof(*bbs));
+	child = malloc(nr * 5 * sizeof(int));
+	if (nr > dom_nr) {
+		free(dom_enter);
+		dom_nr = nr;
+		dom_enter = malloc(nr * 2 * sizeof(int));
 	}
-	if (bb_dominates(ep, b1, b2, ++bb_generation))
-		return cse_one_instruction(i2, i1);
-
-	if (bb_dominates(ep, b2, b1, ++bb_generation))
-		return cse_one_instruction(i1, i2);
-
-	/* No direct dominance - but we could try to find a common ancestor.. */
-	common = trivial_common_parent(b1, b2);
-	if (common) {
-		i1 = cse_one_instruction(i2, i1);
-		remove_instruction(&b1->insns, i1, 1);
-		add_instruction_to_end(i1, common);
+	if (!bbs || !child || !dom_enter)
+		die("out of memory for the dominator tree");
+	dom_leave = dom_enter + dom_nr;
+	sibling = child + nr;
+	depth = sibling + nr;
+	stack = depth + nr;
+	for (i = 0; i < nr; i++)
+		child[i] = -1;
+	FOR_EACH_PTR(ep->bbs, bb) {
+		if (bb->dom_generation != entry->dom_generation)
+			continue;
+		if (bbs[bb->postorder])
+			continue;
+		bbs[bb->postorder] = bb;
+		if (bb == entry)
+			continue;
+		sibling[bb->postorder] = child[bb->idom->postorder];
+		child[bb->idom->postorder] = bb->postorder;
+	} END_FOR_EACH_PTR(bb);
+
+	stack[top++] = entry->postorder;
+	while (top) {
+		int n = stack[--top];
+
+		if (n < 0) {
+			leave_scope(depth[~n]);
+			dom_leave[~n] = clock++;
+			continue;
+		}
+		dom_enter[n] = clock++;
+		depth[n] = scope_nr;
+		/* a branch to an undefined label has a block outside ep->bbs */
+		if (bbs[n]) {
+			cse_one_bb(bbs[n]);
+			hoist_common_insns(bbs[n]);
+		}
+		/* a block and its exit are each pushed once: 2 * nr at most */
+		stack[top++] = ~n;
+		for (i = child[n]; i >= 0; i = sibling[i])
+			stack[top++] = i;
 	}
+	free(child);
+	free(bbs);
+}
+
+/* The table of the incremental rounds: every instruction, no scopes */
+static void fill_value_table(struct entrypoint *ep)
+{
+	struct basic_block *bb;
+	struct instruction *insn;
 
-	return i1;
+	FOR_EACH_PTR(ep->bbs, bb) {
+		FOR_EACH_PTR(bb->insns, insn) {
+			long hash;
+
+			if (!insn->bb)
+				continue;
+			hash = insn_hash(insn);
+			if (hash >= 0)
+				add_instruction(insn_hash_table + hash, insn);
+		} END_FOR_EACH_PTR(insn);
+	} END_FOR_EACH_PTR(bb);
+	value_table_filled = 1;
 }
 
-void cleanup_and_cse(struct entrypoint *ep)
+/* Does "a" come before "b" in their (common) block? */
+static int insn_before(struct instruction *a, struct instruction *b)
+{
+	struct instruction *insn;
+
+	FOR_EACH_PTR(a->bb->insns, insn) {
+		if (insn == a)
+			return 1;
+		if (insn == b)
+			return 0;
+	} END_FOR_EACH_PTR(insn);
+	return 0;
+}
+
+static int insn_dominates(struct instruction *dom, struct instruction *insn)
 {
-	int i;
+	struct basic_block *a = dom->bb, *b = insn->bb;
 
-	simplify_memops(ep);
+	if (a == b)
+		return insn_before(dom, insn);
+	if (a->dom_generation != cse_generation || b->dom_generation != cse_generation)
+		return 0;
+	return dom_enter[a->postorder] < dom_enter[b->postorder] &&
+		dom_leave[b->postorder] < dom_leave[a->postorder];
+}
+
+/*
+ * Look "insn" up among all the instructions of the function.  It goes
+ * away if one of the same value dominates it, and the ones it dominates
+ * go away instead of it.  Two copies in blocks which don't dominate one
+ * another are both kept, as the full walk would do.
+ */
+static void cse_insn_value(struct instruction *insn)
+{
+	struct instruction *def;
+	long hash = insn_hash(insn);
+
+	if (hash < 0)
+		return;
+	FOR_EACH_PTR(insn_hash_table[hash], def) {
+		if (def == insn || !def->bb || insn_compare(def, insn))
+			continue;
+		if (insn_dominates(def, insn)) {
+			cse_one_instruction(insn, def);
+			return;
+		}
+		if (insn_dominates(insn, def))
+			cse_one_instruction(def, insn);
+	} END_FOR_EACH_PTR(def);
+	add_instruction(insn_hash_table + hash, insn);
+}
+
+/*
+ * The instructions simplify queued are the only ones whose value can
+ * have changed since the last round, so they are the only ones to look
+ * up.  The CFG is the same, so is the dominator tree.
+ */
+static void cse_worklist_insns(struct entrypoint *ep)
+{
+	struct instruction_list *list = cse_worklist;
+	struct instruction *insn;
+
+	cse_worklist = NULL;
+	if (list && !value_table_filled)
+		fill_value_table(ep);
+	FOR_EACH_PTR(list, insn) {
+		if (insn->bb)
+			cse_insn_value(insn);
+	} END_FOR_EACH_PTR(insn);
+	free_ptr_list((struct ptr_list **)&list);
+}
+
+static void drop_worklists(void)
+{
+	free_ptr_list((struct ptr_list **)&insn_worklist);
+	free_ptr_list((struct ptr_list **)&cse_worklist);
+	free_ptr_list(&bb_worklist);
+	free_ptr_list(&memops_worklist);
+}
+
+void start_cleanup(struct entrypoint *ep)
+{
+	drop_worklists();
+	worklist_ep = ep;
+	need_full_pass = 1;
+	need_memops = 1;
+	cse_generation = 0;
+}
+
+void end_cleanup(struct entrypoint *ep)
+{
+	assert(worklist_ep == ep);
+	drop_worklists();
+	worklist_ep = NULL;
+	free_insn_hash();
+	free(dom_enter);
+	dom_enter = NULL;
+	dom_nr = 0;
+}
+
+/*
+ * Looking the queued instructions up one by one costs more than a walk
+ * once they are a good part of the function: an instruction is compared
+ * with all its copies which don't dominate it, where the walk only sees
+ * the ones in the blocks above it.
+ */
+static int need_cse_walk(struct entrypoint *ep)
+{
+	if (!ep->dom_generation || ep->dom_generation != cse_generation)
+		return 1;
+	return ptr_list_size((struct ptr_list *)cse_worklist) * 8 > cse_insn_nr;
+}
+
+/*
+ * The first call after start_cleanup() looks at the whole function,
+ * the following ones only at what was queued since.  The CSE walks the
+ * dominator tree again only if it is not the one of the last walk, or
+ * if much of the function was queued.
+ */
+void cleanup_and_cse(struct entrypoint *ep)
+{
+	assert(worklist_ep == ep);
 repeat:
+	/* that can come from the CFG passes too */
+	if (repeat_phase & REPEAT_SYMBOL_CLEANUP)
+		need_memops = 1;
+	if (need_memops) {
+		free_ptr_list(&memops_worklist);
+		simplify_memops(ep);
+		need_memops = 0;
+	} else {
+		simplify_memops_list(&memops_worklist);
+	}
+
 	repeat_phase = 0;
-	clean_up_insns(ep);
+	if (need_full_pass) {
+		drop_worklists();
+		clean_up_insns(ep);
+		need_full_pass = 0;
+	} else {
+		clean_up_worklist();
+	}
 	if (repeat_phase & REPEAT_CFG_CLEANUP)
 		kill_unreachable_bbs(ep);
-	for (i = 0; i < INSN_HASH_SIZE; i++) {
-		struct instruction_list **list = insn_hash_table + i;
-		if (*list) {
-			if (instruction_list_size(*list) > 1) {
-				struct instruction *insn, *last;
-
-				sort_instruction_list(list);
-
-				last = NULL;
-				FOR_EACH_PTR(*list, insn) {
-					if (!insn->bb)
-						continue;
-					if (last) {
-						if (!insn_compare(last, insn))
-							insn = try_to_cse(ep, last, insn);
-					}
-					last = insn;
-				} END_FOR_EACH_PTR(insn);
-			}
-			free_ptr_list((struct ptr_list **)list);
-		}
+	if (need_cse_walk(ep)) {
+		free_ptr_list((struct ptr_list **)&cse_worklist);
+		cse_dominator_walk(ep);
+	} else {
+		cse_worklist_insns(ep);
 	}
 
-	if (repeat_phase & REPEAT_SYMBOL_CLEANUP)
-		simplify_memops(ep);
-
 	if (repeat_phase & REPEAT_CSE)
 		goto repeat;
 }
@@ -397,6 +397,7 @@ struct token *primary_expression(struct token *token, struct expression **tree)
 		struct symbol *sym = lookup_symbol(token->ident, NS_SYMBOL | NS_TYPEDEF);
 		struct token *next = token->next;
 
+		token->ident->seen = 1;
 		if (!sym) {
 			sym = handle_func(token);
 			if (token->ident == &__builtin_types_compatible_p_ident) {
@@ -36,10 +36,14 @@ static int rewrite_branch(struct basic_block *bb,
 	/* We might find new if-conversions or non-dominating CSEs */
 	/* we may also create new dead cycles */
 	repeat_phase |= REPEAT_CSE | REPEAT_CFG_CLEANUP;
+	invalidate_dominators(bb->ep);
 	*ptr = new;
 	replace_bb_in_list(&bb->children, old, new, 1);
 	remove_bb_from_list(&old->parents, bb, 1);
 	add_bb(&new->parents, bb);
+	queue_bb(bb);
+	queue_bb(old);
+	queue_bb(new);
 	return 1;
 }
 
@@ -286,6 +290,7 @@ void convert_instruction_target(struct instruction *insn, pseudo_t src)
 		if (*pu->userp != VOID) {
 			assert(*pu->userp == target);
 			*pu->userp = src;
+			queue_insn(pu->insn);
 		}
 	} END_FOR_EACH_PTR(pu);
 	if (has_use_list(src))
@@ -373,9 +378,27 @@ static int phisrc_in_bb(struct pseudo_list *list, struct basic_block *bb)
 	return 0;
 }
 
+/*
+ * Only the loads and stores of a local symbol can dominate an access to
+ * it, so the walks over the parents can skip the blocks without any.
+ */
+unsigned long mark_access_bbs(pseudo_t pseudo)
+{
+	unsigned long generation = ++bb_generation;
+	struct pseudo_user *pu;
+
+	FOR_EACH_PTR(pseudo->users, pu) {
+		struct instruction *insn = pu->insn;
+
+		if (insn->bb)
+			insn->bb->access_generation = generation;
+	} END_FOR_EACH_PTR(pu);
+	return generation;
+}
+
 static int find_dominating_parents(pseudo_t pseudo, struct instruction *insn,
 	struct basic_block *bb, unsigned long generation, struct pseudo_list **dominators,
-	int local)
+	int local, unsigned long access)
 {
 	struct basic_block *parent;
 
@@ -387,6 +410,8 @@ static int find_dominating_parents(pseudo_t pseudo, struct instruction *insn,
 		struct instruction *br;
 		pseudo_t phi;
 
+		if (access && parent->access_generation != access)
+			goto no_dominance;
 		FOR_EACH_PTR_REVERSE(parent->insns, one) {
 			int dominance;
 			if (one == insn)
@@ -406,7 +431,7 @@ no_dominance:
 			continue;
 		parent->generation = generation;
 
-		if (!find_dominating_parents(pseudo, insn, parent, generation, dominators, local))
+		if (!find_dominating_parents(pseudo, insn, parent, generation, dominators, local, access))
 			return 0;
 		continue;
 
@@ -460,8 +485,42 @@ complex_phi:
 	insn->phi_list = dominators;
 }
 
+/*
+ * Only the loads and stores of a local symbol can dominate an access, so
+ * instead of scanning the whole block up to "insn" look at the other
+ * users in the same block and take the last one before it.
+ */
+static int find_local_dominator(pseudo_t pseudo, struct instruction *insn,
+	struct instruction **dom)
+{
+	struct instruction *last = NULL;
+	struct pseudo_user *pu;
+	int last_dominance = 0;
+
+	FOR_EACH_PTR(pseudo->users, pu) {
+		struct instruction *one = pu->insn;
+		int dominance;
+
+		if (one->bb != insn->bb || one->index >= insn->index)
+			continue;
+		if (last && one->index < last->index)
+			continue;
+		dominance = dominates(pseudo, insn, one, 1);
+		if (!dominance)
+			continue;
+		/* Ignore partial load dominators */
+		if (dominance < 0 && one->opcode == OP_LOAD)
+			continue;
+		last = one;
+		last_dominance = dominance;
+	} END_FOR_EACH_PTR(pu);
+
+	*dom = last_dominance > 0 ? last : NULL;
+	return last_dominance < 0;
+}
+
 static int find_dominating_stores(pseudo_t pseudo, struct instruction *insn,
-	unsigned long generation, int local)
+	unsigned long generation, int local, unsigned long access)
 {
 	struct basic_block *bb = insn->bb;
 	struct instruction *one, *dom = NULL;
@@ -474,6 +533,11 @@ static int find_dominating_stores(pseudo_t pseudo, struct instruction *insn,
 		return 1;
 	}
 
+	if (local) {
+		partial = find_local_dominator(pseudo, insn, &dom);
+		goto found;
+	}
+
 	partial = 0;
 	FOR_EACH_PTR(bb->insns, one) {
 		int dominance;
@@ -509,7 +573,7 @@ found:
 	bb->generation = generation;
 
 	dominators = NULL;
-	if (!find_dominating_parents(pseudo, insn, bb, generation, &dominators, local))
+	if (!find_dominating_parents(pseudo, insn, bb, generation, &dominators, local, access))
 		return 0;
 
 	/* This happens with initial assignments to structures etc.. */
@@ -648,11 +712,352 @@ void check_access(struct instruction *insn)
 	}
 }
 
+/*
+ * SSA construction for the local symbols which are only ever loaded and
+ * stored whole.  The phi-nodes go on the iterated dominance frontier of
+ * the blocks which store to the symbol.  A load then gets the value of
+ * the last store before it in its block, or the phi-node of its block,
+ * or the value reaching the end of its immediate dominator.  Symbols
+ * which are accessed in pieces still go through find_dominating_stores().
+ */
+static int ssa_convertible(struct entrypoint *ep, pseudo_t pseudo, struct instruction **model)
+{
+	unsigned long generation = ep->dom_generation;
+	struct instruction *first = NULL;
+	struct pseudo_user *pu;
+
+	if (!generation)
+		return 0;
+	FOR_EACH_PTR(pseudo->users, pu) {
+		struct instruction *insn = pu->insn;
+
+		if (insn->opcode != OP_LOAD && insn->opcode != OP_STORE)
+			continue;
+		if (!insn->bb || insn->bb->dom_generation != generation)
+			return 0;
+		if (!first)
+			first = insn;
+		else if (!same_memop(first, insn))
+			return 0;
+	} END_FOR_EACH_PTR(pu);
+	*model = first;
+	return first != NULL;
+}
+
+static void ssa_touch_bb(struct basic_block *bb, unsigned long generation)
+{
+	if (bb->ssa_generation == generation)
+		return;
+	bb->ssa_generation = generation;
+	bb->ssa_store = NULL;
+	bb->ssa_phi = NULL;
+	bb->ssa_out = NULL;
+}
+
+/*
+ * The value of the symbol at the end of "bb", or NULL if it has none.
+ * A block without a store or a phi-node has the value of its immediate
+ * dominator.  Once the phi-nodes are placed that doesn't change, so it
+ * is remembered in ssa_out (VOID for none) for every block on the way.
+ */
+static pseudo_t ssa_value_out(struct basic_block *bb, unsigned long generation)
+{
+	struct basic_block *start = bb;
+	pseudo_t val = VOID;
+
+	for (;;) {
+		if (bb->ssa_generation == generation) {
+			if (bb->ssa_store) {
+				val = bb->ssa_store->target;
+				break;
+			}
+			if (bb->ssa_phi) {
+				val = bb->ssa_phi->target;
+				break;
+			}
+			if (bb->ssa_out) {
+				val = bb->ssa_out;
+				break;
+			}
+		}
+		if (bb->idom == bb)
+			break;
+		bb = bb->idom;
+	}
+
+	for (; start != bb; start = start->idom) {
+		ssa_touch_bb(start, generation);
+		start->ssa_out = val;
+	}
+	return val == VOID ? NULL : val;
+}
+
+/* The value of the symbol at the start of "bb", or NULL if it has none */
+static pseudo_t ssa_value_in(struct basic_block *bb, unsigned long generation)
+{
+	if (bb->ssa_generation == generation && bb->ssa_phi)
+		return bb->ssa_phi->target;
+	if (bb->idom == bb)
+		return NULL;
+	return ssa_value_out(bb->idom, generation);
+}
+
+static void ssa_place_phis(pseudo_t pseudo, struct symbol *type, unsigned long generation,
+	struct instruction_list **phis)
+{
+	unsigned long queued = ++bb_generation;
+	struct basic_block_list *worklist = NULL;
+	struct basic_block *bb, *df;
+	struct pseudo_user *pu;
+
+	FOR_EACH_PTR(pseudo->users, pu) {
+		struct instruction *insn = pu->insn;
+
+		if (insn->opcode != OP_STORE)
+			continue;
+		bb = insn->bb;
+		ssa_touch_bb(bb, generation);
+		if (!bb->ssa_store || bb->ssa_store->index < insn->index)
+			bb->ssa_store = insn;
+		if (bb->generation == queued)
+			continue;
+		bb->generation = queued;
+		add_bb(&worklist, bb);
+	} END_FOR_EACH_PTR(pu);
+
+	while ((bb = delete_last_basic_block(&worklist))) {
+		FOR_EACH_PTR(bb->frontier, df) {
+			ssa_touch_bb(df, generation);
+			if (df->ssa_phi)
+				continue;
+			df->ssa_phi = insert_phi_node(df, type);
+			df->ssa_phi->target->ident = pseudo->ident;
+			add_instruction(phis, df->ssa_phi);
+			if (df->generation == queued)
+				continue;
+			df->generation = queued;
+			add_bb(&worklist, df);
+		} END_FOR_EACH_PTR(df);
+	}
+}
+
+static void ssa_rename_load(struct instruction *insn, pseudo_t val)
+{
+	if (!val) {
+		/* Nothing stored on any path: same as the initial assignments */
+		check_access(insn);
+		val = value_pseudo(insn->type, 0);
+	}
+	convert_load_instruction(insn, val);
+}
+
+/*
+ * The loads of a block which also stores to the symbol get the value
+ * of the last store before them, so walk the block once, in order.
+ */
+static void ssa_rename_bb(pseudo_t pseudo, struct basic_block *bb, unsigned long generation)
+{
+	pseudo_t val = ssa_value_in(bb, generation);
+	struct instruction *insn;
+
+	FOR_EACH_PTR(bb->insns, insn) {
+		if (!insn->bb || insn->src != pseudo)
+			continue;
+		if (insn->opcode == OP_STORE)
+			val = insn->target;
+		else if (insn->opcode == OP_LOAD)
+			ssa_rename_load(insn, val);
+	} END_FOR_EACH_PTR(insn);
+}
+
+/* Paths where nothing was stored don't get a phi-source, like before */
+static void ssa_fill_phi(pseudo_t pseudo, struct instruction *phi_node, unsigned long generation)
+{
+	struct basic_block *bb = phi_node->bb, *parent;
+
+	FOR_EACH_PTR(bb->parents, parent) {
+		struct instruction *br;
+		pseudo_t val, phi;
+
+		if (parent->dom_generation != bb->dom_generation)
+			continue;
+		if (phisrc_in_bb(phi_node->phi_list, parent))
+			continue;
+		val = ssa_value_out(parent, generation);
+		if (!val)
+			continue;
+		br = delete_last_instruction(&parent->insns);
+		phi = alloc_phi(parent, val, phi_node->size);
+		phi->ident = phi->ident ? : pseudo->ident;
+		add_instruction(&parent->insns, br);
+		use_pseudo(phi_node, phi, add_pseudo(&phi_node->phi_list, phi));
+	} END_FOR_EACH_PTR(parent);
+}
+
+/*
+ * A phi-node whose sources are all the same value, apart from itself
+ * around a loop, is just that value.  Removing one can make another one
+ * trivial, so keep going until nothing changes.
+ */
+static int ssa_remove_trivial_phi(struct instruction *phi_node)
+{
+	pseudo_t phi, same = NULL;
+
+	FOR_EACH_PTR(phi_node->phi_list, phi) {
+		pseudo_t src;
+
+		if (phi == VOID || !phi->def)
+			continue;
+		src = phi->def->phi_src;
+		if (src == phi_node->target || src == same)
+			continue;
+		if (same)
+			return 0;
+		same = src;
+	} END_FOR_EACH_PTR(phi);
+
+	if (!same)
+		same = value_pseudo(phi_node->type, 0);
+	convert_instruction_target(phi_node, same);
+	FOR_EACH_PTR(phi_node->phi_list, phi) {
+		if (phi != VOID && phi->def)
+			kill_instruction(phi->def);
+	} END_FOR_EACH_PTR(phi);
+	kill_instruction(phi_node);
+	return 1;
+}
+
+static int ssa_is_phi(pseudo_t pseudo, unsigned long generation)
+{
+	struct instruction *def;
+
+	if (pseudo->type != PSEUDO_REG)
+		return 0;
+	def = pseudo->def;
+	if (!def || def->opcode != OP_PHI || !def->bb)
+		return 0;
+	return def->bb->ssa_generation == generation && def->bb->ssa_phi == def;
+}
+
+/* Is the phi-node used by anything else than the phi-nodes of the symbol? */
+static int ssa_phi_used(struct instruction *phi_node, unsigned long generation)
+{
+	struct pseudo_user *pu, *su;
+
+	FOR_EACH_PTR(phi_node->target->users, pu) {
+		struct instruction *insn = pu->insn;
+
+		if (!insn->bb)
+			continue;
+		if (insn->opcode != OP_PHISOURCE)
+			return 1;
+		FOR_EACH_PTR(insn->target->users, su) {
+			if (!ssa_is_phi(su->insn->target, generation))
+				return 1;
+		} END_FOR_EACH_PTR(su);
+	} END_FOR_EACH_PTR(pu);
+	return 0;
+}
+
+/*
+ * The phi-nodes are placed wherever the stores meet, even where the
+ * symbol isn't used anymore.  Those only feed each other around the
+ * loops, so kill everything which can't reach a real use.
+ */
+static void ssa_prune_phis(struct instruction_list *phis, unsigned long generation)
+{
+	unsigned long live = ++bb_generation;
+	struct instruction_list *worklist = NULL;
+	struct instruction *phi_node;
+	pseudo_t phi;
+
+	FOR_EACH_PTR(phis, phi_node) {
+		if (!ssa_phi_used(phi_node, generation))
+			continue;
+		phi_node->bb->generation = live;
+		add_instruction(&worklist, phi_node);
+	} END_FOR_EACH_PTR(phi_node);
+
+	while ((phi_node = delete_last_instruction(&worklist))) {
+		FOR_EACH_PTR(phi_node->phi_list, phi) {
+			pseudo_t src;
+
+			if (phi == VOID || !phi->def)
+				continue;
+			src = phi->def->phi_src;
+			if (!ssa_is_phi(src, generation))
+				continue;
+			if (src->def->bb->generation == live)
+				continue;
+			src->def->bb->generation = live;
+			add_instruction(&worklist, src->def);
+		} END_FOR_EACH_PTR(phi);
+	}
+	free_ptr_list(&worklist);
+
+	FOR_EACH_PTR(phis, phi_node) {
+		if (phi_node->bb && phi_node->bb->generation != live)
+			kill_instruction_force(phi_node);
+	} END_FOR_EACH_PTR(phi_node);
+}
+
+static void ssa_convert_symbol(pseudo_t pseudo, struct instruction *model)
+{
+	unsigned long generation = ++bb_generation;
+	unsigned long renamed;
+	struct instruction_list *phis = NULL;
+	struct basic_block *bb;
+	struct instruction *insn;
+	struct pseudo_user *pu;
+	int changed;
+
+	ssa_place_phis(pseudo, model->type, generation, &phis);
+
+	renamed = ++bb_generation;
+	FOR_EACH_PTR(pseudo->users, pu) {
+		insn = pu->insn;
+		if (insn->opcode != OP_LOAD)
+			continue;
+		bb = insn->bb;
+		if (bb->ssa_generation != generation || !bb->ssa_store) {
+			ssa_rename_load(insn, ssa_value_in(bb, generation));
+			continue;
+		}
+		if (bb->generation == renamed)
+			continue;
+		bb->generation = renamed;
+		ssa_rename_bb(pseudo, bb, generation);
+	} END_FOR_EACH_PTR(pu);
+
+	FOR_EACH_PTR(phis, insn) {
+		ssa_fill_phi(pseudo, insn, generation);
+	} END_FOR_EACH_PTR(insn);
+	ssa_prune_phis(phis, generation);
+
+	/* all the loads are gone, so the stores are dead */
+	FOR_EACH_PTR(pseudo->users, pu) {
+		insn = pu->insn;
+		if (insn->opcode == OP_STORE)
+			kill_store(insn);
+	} END_FOR_EACH_PTR(pu);
+
+	do {
+		changed = 0;
+		FOR_EACH_PTR(phis, insn) {
+			if (!insn->bb)
+				continue;
+			changed |= ssa_remove_trivial_phi(insn);
+		} END_FOR_EACH_PTR(insn);
+	} while (changed);
+	free_ptr_list(&phis);
+}
+
 static void simplify_one_symbol(struct entrypoint *ep, struct symbol *sym)
 {
 	pseudo_t pseudo;
 	struct pseudo_user *pu;
-	unsigned long mod;
+	struct instruction *model;
+	unsigned long mod, access;
 	int all;
 
 	/* Never used as a symbol? */
@@ -693,12 +1098,18 @@ static void simplify_one_symbol(struct entrypoint *ep, struct symbol *sym)
 		}
 	} END_FOR_EACH_PTR(pu);
 
+	if (ssa_convertible(ep, pseudo, &model)) {
+		ssa_convert_symbol(pseudo, model);
+		return;
+	}
+
 external_visibility:
 	all = 1;
+	access = mod ? 0 : mark_access_bbs(pseudo);
 	FOR_EACH_PTR_REVERSE(pseudo->users, pu) {
 		struct instruction *insn = pu->insn;
 		if (insn->opcode == OP_LOAD)
-			all &= find_dominating_stores(pseudo, insn, ++bb_generation, !mod);
+			all &= find_dominating_stores(pseudo, insn, ++bb_generation, !mod, access);
 	} END_FOR_EACH_PTR_REVERSE(pu);
 
 	/* If we converted all the loads, remove the stores. They are dead */
@@ -731,13 +1142,65 @@ external_visibility:
 	return;
 }
 
+/*
+ * The dominance frontier of a block is where its dominance stops: the
+ * blocks with a parent it dominates which it doesn't strictly dominate
+ * itself.  Only the join points can be in one.
+ */
+static void build_dominance_frontiers(struct entrypoint *ep)
+{
+	unsigned long generation = ep->dom_generation;
+	struct basic_block *bb, *parent;
+
+	FOR_EACH_PTR(ep->bbs, bb) {
+		if (bb->dom_generation != generation)
+			continue;
+		if (bb_list_size(bb->parents) < 2)
+			continue;
+		FOR_EACH_PTR(bb->parents, parent) {
+			struct basic_block *runner = parent;
+
+			if (runner->dom_generation != generation)
+				continue;
+			while (runner != bb->idom) {
+				if (last_basic_block(runner->frontier) != bb)
+					add_bb(&runner->frontier, bb);
+				if (runner->idom == runner)
+					break;
+				runner = runner->idom;
+			}
+		} END_FOR_EACH_PTR(parent);
+	} END_FOR_EACH_PTR(bb);
+}
+
 void simplify_symbol_usage(struct entrypoint *ep)
 {
+	struct basic_block *bb;
 	pseudo_t pseudo;
 
+	FOR_EACH_PTR(ep->bbs, bb) {
+		struct instruction *insn;
+		unsigned int index = 0;
+
+		FOR_EACH_PTR(bb->insns, insn) {
+			insn->index = index++;
+		} END_FOR_EACH_PTR(insn);
+	} END_FOR_EACH_PTR(bb);
+
+	/* an entry with parents is a loop header; don't bother with SSA then */
+	ep->dom_generation = 0;
+	if (!ep->entry->bb->parents) {
+		build_dominator_tree(ep);
+		build_dominance_frontiers(ep);
+	}
+
 	FOR_EACH_PTR(ep->accesses, pseudo) {
 		simplify_one_symbol(ep, pseudo->sym);
 	} END_FOR_EACH_PTR(pseudo);
+
+	FOR_EACH_PTR(ep->bbs, bb) {
+		free_ptr_list(&bb->frontier);
+	} END_FOR_EACH_PTR(bb);
 }
 
 static void mark_bb_reachable(struct basic_block *bb, unsigned long generation)
@@ -752,6 +1215,153 @@ static void mark_bb_reachable(struct basic_block *bb, unsigned long generation)
 	} END_FOR_EACH_PTR(child);
 }
 
+/*
+ * Dominator tree, from Cooper, Harvey and Kennedy's "A Simple, Fast
+ * Dominance Algorithm".  Reachable blocks are numbered in postorder so
+ * that a dominator always has a higher number than the blocks it
+ * dominates.  The tree is only valid until the CFG changes again.
+ */
+static void number_bbs(struct basic_block *entry, unsigned long generation,
+	struct basic_block ***order, int *nr, int *max)
+{
+	/*
+	 * Iterative depth-first walk: a block is pushed once to be expanded
+	 * and once more, tagged, under its children to be numbered after them.
+	 */
+	static struct number_bbs_slot {
+		struct basic_block *bb;
+		int numbered;
+	} *stack;
+	static int stack_max;
+	int top = 0;
+
+	stack_max = stack_max ? stack_max : 64;
+	stack = stack ? stack : malloc(stack_max * sizeof(*stack));
+	stack[top++] = (struct number_bbs_slot) { entry, 0 };
+	while (top) {
+		struct number_bbs_slot slot = stack[--top];
+		struct basic_block *bb = slot.bb, *child;
+
+		if (slot.numbered) {
+			if (*nr >= *max) {
+				*max = *max ? *max * 2 : 64;
+				*order = realloc(*order, *max * sizeof(**order));
+			}
+			bb->postorder = *nr;
+			(*order)[(*nr)++] = bb;
+			continue;
+		}
+		if (bb->dom_generation == generation)
+			continue;
+		bb->dom_generation = generation;
+		bb->idom = NULL;
+		stack[top++] = (struct number_bbs_slot) { bb, 1 };
+		FOR_EACH_PTR_REVERSE(bb->children, child) {
+			if (!child || child->dom_generation == generation)
+				continue;
+			if (top >= stack_max) {
+				stack_max *= 2;
+				stack = realloc(stack, stack_max * sizeof(*stack));
+			}
+			stack[top++] = (struct number_bbs_slot) { child, 0 };
+		} END_FOR_EACH_PTR_REVERSE(child);
+	}
+}
+
+static struct basic_block *intersect_doms(struct basic_block *a, struct basic_block *b)
+{
+	while (a != b) {
+		while (a->postorder < b->postorder)
+			a = a->idom;
+		while (b->postorder < a->postorder)
+			b = b->idom;
+	}
+	return a;
+}
+
+/*
+ * Number the blocks reachable from the entry in postorder.  The blocks of
+ * the entrypoint which can't be reached come last, starting at *reached.
+ * Renumbering invalidates the dominator tree.
+ */
+int postorder_bbs(struct entrypoint *ep, struct basic_block ***orderp, int *reached)
+{
+	unsigned long generation = ++bb_generation;
+	static struct basic_block **order;
+	static int max;
+	struct basic_block *bb;
+	int nr = 0;
+
+	number_bbs(ep->entry->bb, generation, &order, &nr, &max);
+	*reached = nr;
+	FOR_EACH_PTR(ep->bbs, bb) {
+		if (bb->dom_generation == generation)
+			continue;
+		if (nr >= max) {
+			max *= 2;
+			order = realloc(order, max * sizeof(*order));
+		}
+		bb->postorder = nr;
+		order[nr++] = bb;
+	} END_FOR_EACH_PTR(bb);
+	ep->dom_generation = 0;
+	*orderp = order;
+	return nr;
+}
+
+void build_dominator_tree(struct entrypoint *ep)
+{
+	struct basic_block *entry = ep->entry->bb;
+	struct basic_block **order;
+	unsigned long generation;
+	int nr, changed, i;
+
+	postorder_bbs(ep, &order, &nr);
+	generation = entry->dom_generation;
+	entry->idom = entry;
+	do {
+		changed = 0;
+		/* reverse postorder, skipping the entry */
+		for (i = nr - 2; i >= 0; i--) {
+			struct basic_block *bb = order[i];
+			struct basic_block *parent, *idom = NULL;
+
+			FOR_EACH_PTR(bb->parents, parent) {
+				if (parent->dom_generation != generation || !parent->idom)
+					continue;
+				idom = idom ? intersect_doms(parent, idom) : parent;
+			} END_FOR_EACH_PTR(parent);
+			if (idom != bb->idom) {
+				bb->idom = idom;
+				changed = 1;
+			}
+		}
+	} while (changed);
+	ep->dom_generation = generation;
+}
+
+/* Any change to the edges of the CFG makes the tree wrong */
+void invalidate_dominators(struct entrypoint *ep)
+{
+	if (ep)
+		ep->dom_generation = 0;
+}
+
+/*
+ * Does "dom" dominate "bb"?  Returns -1 if the tree built for the
+ * entrypoint doesn't know about one of them.
+ */
+int bb_dominated_by(struct entrypoint *ep, struct basic_block *bb, struct basic_block *dom)
+{
+	unsigned long generation = ep->dom_generation;
+
+	if (bb->dom_generation != generation || dom->dom_generation != generation)
+		return -1;
+	while (bb->postorder < dom->postorder)
+		bb = bb->idom;
+	return bb == dom;
+}
+
 static void kill_defs(struct instruction *insn)
 {
 	pseudo_t target = insn->target;
@@ -769,6 +1379,7 @@ void kill_bb(struct basic_block *bb)
 	struct instruction *insn;
 	struct basic_block *child, *parent;
 
+	invalidate_dominators(bb->ep);
 	FOR_EACH_PTR(bb->insns, insn) {
 		kill_instruction_force(insn);
 		kill_defs(insn);
@@ -781,6 +1392,7 @@ void kill_bb(struct basic_block *bb)
 
 	FOR_EACH_PTR(bb->children, child) {
 		remove_bb_from_list(&child->parents, bb, 0);
+		queue_bb(child);
 	} END_FOR_EACH_PTR(child);
 	bb->children = NULL;
 
@@ -937,6 +1549,88 @@ void vrfy_flow(struct entrypoint *ep)
 	assert(!entry);
 }
 
+/*
+ * Is "phisrc" the only phi-source of its phi-node which can be in
+ * "parent"?  The phi-node must be in "child".
+ */
+static int phisrc_movable(struct instruction *phisrc, struct basic_block *parent,
+	struct basic_block *child)
+{
+	struct pseudo_user *pu;
+	pseudo_t phi;
+
+	FOR_EACH_PTR(phisrc->target->users, pu) {
+		struct instruction *phi_node = pu->insn;
+
+		if (!phi_node->bb)
+			continue;
+		if (phi_node->opcode != OP_PHI || phi_node->bb != child)
+			return 0;
+		FOR_EACH_PTR(phi_node->phi_list, phi) {
+			if (phi == VOID || !phi->def)
+				continue;
+			if (phi->def->bb == parent)
+				return 0;
+		} END_FOR_EACH_PTR(phi);
+	} END_FOR_EACH_PTR(pu);
+	return 1;
+}
+
+/*
+ * A block with nothing but phi-sources and a branch is left on the
+ * edge from a conditional branch to a join when the phi-nodes are
+ * filled.  If the parent doesn't branch to the join itself, the
+ * phi-sources can go at the end of the parent.  The path which doesn't
+ * go to the join ignores them, and the block is then just a branch.
+ */
+static int hoist_phi_sources(struct basic_block *bb)
+{
+	struct instruction_list *rest = NULL;
+	struct basic_block *parent, *child;
+	struct instruction *insn, *br, *last;
+	int nr = 0;
+
+	if (bb_list_size(bb->parents) != 1)
+		return 0;
+	parent = first_basic_block(bb->parents);
+	last = last_instruction(parent->insns);
+	if (parent == bb || !last || last->opcode != OP_CBR)
+		return 0;
+	br = last_instruction(bb->insns);
+	if (!br || br->opcode != OP_BR)
+		return 0;
+	child = br->bb_true;
+	if (child == parent || child == bb ||
+	    last->bb_true == child || last->bb_false == child)
+		return 0;
+
+	FOR_EACH_PTR(bb->insns, insn) {
+		if (!insn->bb || insn == br)
+			continue;
+		if (insn->opcode != OP_PHISOURCE)
+			return 0;
+		if (!phisrc_movable(insn, parent, child))
+			return 0;
+		nr++;
+	} END_FOR_EACH_PTR(insn);
+	if (!nr)
+		return 0;
+
+	delete_last_instruction(&parent->insns);
+	FOR_EACH_PTR(bb->insns, insn) {
+		if (insn->bb && insn->opcode == OP_PHISOURCE) {
+			insn->bb = parent;
+			add_instruction(&parent->insns, insn);
+		} else {
+			add_instruction(&rest, insn);
+		}
+	} END_FOR_EACH_PTR(insn);
+	add_instruction(&parent->insns, last);
+	free_ptr_list(&bb->insns);
+	bb->insns = rest;
+	return 1;
+}
+
 void pack_basic_blocks(struct entrypoint *ep)
 {
 	struct basic_block *bb;
@@ -949,6 +1643,9 @@ void pack_basic_blocks(struct entrypoint *ep)
 		if (!bb_reachable(bb))
 			continue;
 
+		if (hoist_phi_sources(bb))
+			repeat_phase |= REPEAT_CSE;
+
 		/*
 		 * Just a branch?
 		 */
@@ -1003,6 +1700,7 @@ out:
 		 * Merge the two.
 		 */
 		repeat_phase |= REPEAT_CSE;
+		invalidate_dominators(ep);
 
 		parent->children = bb->children;
 		bb->children = NULL;
@@ -1010,6 +1708,7 @@ out:
 
 		FOR_EACH_PTR(parent->children, child) {
 			replace_bb_in_list(&child->parents, bb, parent, 0);
+			queue_bb(child);
 		} END_FOR_EACH_PTR(child);
 
 		kill_instruction(delete_last_instruction(&parent->insns));
@@ -1021,6 +1720,7 @@ out:
 			add_instruction(&parent->insns, insn);
 		} END_FOR_EACH_PTR(insn);
 		bb->insns = NULL;
+		queue_bb(parent);
 
 	no_merge:
 		/* nothing to do */;
@@ -16,16 +16,26 @@ extern int simplify_flow(struct entrypoint *ep);
 
 extern void simplify_symbol_usage(struct entrypoint *ep);
 extern void simplify_memops(struct entrypoint *ep);
+extern void simplify_memops_list(struct basic_block_list **list);
 extern void pack_basic_blocks(struct entrypoint *ep);
 
 extern void convert_instruction_target(struct instruction *insn, pseudo_t src);
+extern void start_cleanup(struct entrypoint *ep);
 extern void cleanup_and_cse(struct entrypoint *ep);
+extern void end_cleanup(struct entrypoint *ep);
+extern void queue_insn(struct instruction *insn);
+extern void queue_bb(struct basic_block *bb);
 extern int simplify_instruction(struct instruction *);
 
 extern void kill_bb(struct basic_block *);
 extern void kill_use(pseudo_t *);
 extern void kill_unreachable_bbs(struct entrypoint *ep);
 
+extern int postorder_bbs(struct entrypoint *ep, struct basic_block ***order, int *reached);
+extern void build_dominator_tree(struct entrypoint *ep);
+extern void invalidate_dominators(struct entrypoint *ep);
+extern int bb_dominated_by(struct entrypoint *ep, struct basic_block *bb, struct basic_block *dom);
+
 extern void kill_insn(struct instruction *, int force);
 static inline void kill_instruction(struct instruction *insn)
 {
@@ -40,6 +50,7 @@ void check_access(struct instruction *insn);
 void convert_load_instruction(struct instruction *, pseudo_t);
 void rewrite_load_instruction(struct instruction *, struct pseudo_list *);
 int dominates(pseudo_t pseudo, struct instruction *insn, struct instruction *dom, int local);
+unsigned long mark_access_bbs(pseudo_t pseudo);
 
 extern void clear_liveness(struct entrypoint *ep);
 extern void track_pseudo_liveness(struct entrypoint *ep);
@@ -0,0 +1,793 @@
+/*
+ * Copyright (C) 2020 Dan Carpenter.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see http://www.gnu.org/copyleft/gpl.txt
+ */
+
+/*
+ * This does the work of the smatch_scripts/gen_*.sh scripts in one pass
+ * over smatch_warns.txt.  Each line is handed to the tables which care
+ * about it and at the end every table is sorted, filtered through its
+ * .remove list and written out as <project>.<table> in the current
+ * directory, with the same contents as the scripts produce.
+ *
+ * The output is sorted bytewise (like LC_ALL=C sort).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <regex.h>
+#include <unistd.h>
+
+static const char *project = "kernel";
+static const char *data_dir;
+
+static void die(const char *fmt, const char *arg)
+{
+	fprintf(stderr, "gen_smatch_data: ");
+	fprintf(stderr, fmt, arg);
+	fprintf(stderr, "\n");
+	exit(1);
+}
+
+static void *xmalloc(size_t size)
+{
+	void *p = malloc(size);
+
+	if (!p)
+		die("out of memory%s", "");
+	return p;
+}
+
+static void *xrealloc(void *p, size_t size)
+{
+	p = realloc(p, size);
+	if (!p)
+		die("out of memory%s", "");
+	return p;
+}
+
+static char *xstrndup(const char *s, size_t len)
+{
+	char *p = xmalloc(len + 1);
+
+	memcpy(p, s, len);
+	p[len] = '\0';
+	return p;
+}
+
+/*
+ * A counted set of strings.  "count" is how many times a line was
+ * collected, which matters for the tables that are not de-duplicated
+ * before the final "sort | uniq -u".
+ */
+struct str_entry {
+	char *str;
+	unsigned int hash;
+	int count;
+};
+
+struct str_set {
+	struct str_entry *table;
+	unsigned int size, nr;
+};
+
+static unsigned int hash_str(const char *s)
+{
+	unsigned int hash = 2166136261u;
+
+	while (*s)
+		hash = (hash ^ (unsigned char)*s++) * 16777619u;
+	return hash;
+}
+
+static struct str_entry *set_lookup(struct str_set *set, const char *str, unsigned int hash)
+{
+	unsigned int i = hash & (set->size - 1);
+
+	while (set->table[i].str) {
+		if (set->table[i].hash == hash && strcmp(set->table[i].str, str) == 0)
+			break;
+		i = (i + 1) & (set->size - 1);
+	}
+	return &set->table[i];
+}
+
+static void set_grow(struct str_set *set)
+{
+	struct str_entry *old = set->table;
+	unsigned int old_size = set->size, i;
+
+	set->size = old_size ? old_size * 2 : 256;
+	set->table = xmalloc(set->size * sizeof(*set->table));
+	memset(set->table, 0, set->size * sizeof(*set->table));
+	for (i = 0; i < old_size; i++) {
+		if (old[i].str)
+			*set_lookup(set, old[i].str, old[i].hash) = old[i];
+	}
+	free(old);
+}
+
+/* takes ownership of "str" */
+static void set_add(struct str_set *set, char *str, int count)
+{
+	struct str_entry *e;
+	unsigned int hash;
+
+	if (!str)
+		return;
+	if (set->nr * 2 >= set->size)
+		set_grow(set);
+	hash = hash_str(str);
+	e = set_lookup(set, str, hash);
+	if (e->str) {
+		e->count += count;
+		free(str);
+		return;
+	}
+	e->str = str;
+	e->hash = hash;
+	e->count = count;
+	set->nr++;
+}
+
+static int set_contains(struct str_set *set, const char *str)
+{
+	if (!set->nr)
+		return 0;
+	return set_lookup(set, str, hash_str(str))->str != NULL;
+}
+
+static int cmp_entry(const void *a, const void *b)
+{
+	return strcmp(((const struct str_entry *)a)->str,
+		      ((const struct str_entry *)b)->str);
+}
+
+/*
+ * Helpers which mimic the grep and cut invocations of the scripts.
+ */
+static int ends_with(const char *line, size_t len, const char *s)
+{
+	size_t n = strlen(s);
+
+	return len >= n && memcmp(line + len - n, s, n) == 0;
+}
+
+static int is_word_char(char c)
+{
+	return isalnum((unsigned char)c) || c == '_';
+}
+
+/* grep -w */
+static int has_word(const char *line, const char *word)
+{
+	size_t n = strlen(word);
+	const char *p = line;
+
+	while ((p = strstr(p, word))) {
+		if ((p == line || !is_word_char(p[-1])) && !is_word_char(p[n]))
+			return 1;
+		p++;
+	}
+	return 0;
+}
+
+/*
+ * cut -d <delim> -f <from>-<to>, "to" of 0 meaning the end of the line.
+ * Lines without the delimiter are dropped if "strict" (cut -s) and
+ * printed whole otherwise.
+ */
+static char *cut(const char *line, char delim, int from, int to, int strict)
+{
+	const char *start = NULL, *p = line;
+	int field = 1;
+
+	if (!strchr(line, delim))
+		return strict ? NULL : xstrndup(line, strlen(line));
+
+	if (from == 1)
+		start = line;
+	for (; *p; p++) {
+		if (*p != delim)
+			continue;
+		if (field == to)
+			break;
+		field++;
+		if (field == from)
+			start = p + 1;
+	}
+	if (!start)
+		return xstrndup("", 0);
+	return xstrndup(start, p - start);
+}
+
+/* cut -d ' ' -f 2 | cut -d '(' -f 1 */
+static char *function_name(const char *line, int strict)
+{
+	char *name = cut(line, ' ', 2, 2, strict);
+	char *paren;
+
+	if (name && (paren = strchr(name, '(')))
+		*paren = '\0';
+	return name;
+}
+
+static void delete_char(char *s, char c)
+{
+	char *d = s;
+
+	for (; *s; s++) {
+		if (*s != c)
+			*d++ = *s;
+	}
+	*d = '\0';
+}
+
+/*
+ * The param_mapper links used by trace_params.pl.  Every "func%param"
+ * is a node and "info: param_mapper" lines add an edge from the caller's
+ * parameter to the callee's.  A node is printed for a target if it
+ * matches the target or reaches a node which does.
+ */
+struct param_node {
+	char *name;
+	int *links;
+	int nr_links, alloc_links;
+	int *rev, nr_rev, alloc_rev;
+	int found;
+};
+
+static struct param_node *nodes;
+static int nr_nodes, alloc_nodes;
+static struct str_set node_ids;
+
+static int get_node(const char *name)
+{
+	struct str_entry *e;
+
+	if (node_ids.nr * 2 >= node_ids.size)
+		set_grow(&node_ids);
+	e = set_lookup(&node_ids, name, hash_str(name));
+	if (e->str)
+		return e->count;
+
+	if (nr_nodes == alloc_nodes) {
+		alloc_nodes = alloc_nodes ? alloc_nodes * 2 : 1024;
+		nodes = xrealloc(nodes, alloc_nodes * sizeof(*nodes));
+	}
+	memset(&nodes[nr_nodes], 0, sizeof(*nodes));
+	nodes[nr_nodes].name = xstrndup(name, strlen(name));
+	e->str = nodes[nr_nodes].name;
+	e->hash = hash_str(name);
+	e->count = nr_nodes;
+	node_ids.nr++;
+	return nr_nodes++;
+}
+
+static void push_int(int **array, int *nr, int *alloc, int val)
+{
+	if (*nr == *alloc) {
+		*alloc = *alloc ? *alloc * 2 : 4;
+		*array = xrealloc(*array, *alloc * sizeof(int));
+	}
+	(*array)[(*nr)++] = val;
+}
+
+/* file.c:123 func() info: param_mapper 0 => callee 1 */
+static void add_param_link(const char *line)
+{
+	static const char marker[] = "() info: param_mapper ";
+	const char *m, *p, *name = NULL, *callee, *end;
+	char buf[512];
+	int from, to;
+
+	m = strstr(line, marker);
+	if (!m)
+		return;
+	for (p = line; p < m; p++) {
+		const char *d = p + 1;
+
+		if (*p != ':' || !isdigit((unsigned char)*d))
+			continue;
+		while (isdigit((unsigned char)*d))
+			d++;
+		if (*d == ' ') {
+			name = d + 1;
+			break;
+		}
+	}
+	if (!name || name > m)
+		return;
+
+	p = m + sizeof(marker) - 1;
+	if (!isdigit((unsigned char)*p))
+		return;
+	end = p;
+	while (isdigit((unsigned char)*end))
+		end++;
+	if (strncmp(end, " => ", 4) != 0)
+		return;
+	callee = end + 4;
+
+	/* the callee name runs to the first " <digits>" */
+	for (end = callee; *end; end++) {
+		if (end[0] == ' ' && isdigit((unsigned char)end[1]))
+			break;
+	}
+	if (!*end)
+		return;
+
+	if (snprintf(buf, sizeof(buf), "%.*s%%%d", (int)(m - name), name, atoi(p)) >= sizeof(buf))
+		return;
+	from = get_node(buf);
+	if (snprintf(buf, sizeof(buf), "%.*s%%%d", (int)(end - callee), callee, atoi(end + 1)) >= sizeof(buf))
+		return;
+	to = get_node(buf);
+
+	push_int(&nodes[from].links, &nodes[from].nr_links, &nodes[from].alloc_links, to);
+	push_int(&nodes[to].rev, &nodes[to].nr_rev, &nodes[to].alloc_rev, from);
+}
+
+static void trace_param(struct str_set *out, const char *func, int param)
+{
+	static int generation;
+	char target[256];
+	int *stack, nr = 0, i;
+
+	snprintf(target, sizeof(target), "%s%%%d", func, param);
+	generation++;
+
+	stack = xmalloc((nr_nodes + 1) * sizeof(int));
+	for (i = 0; i < nr_nodes; i++) {
+		if (strstr(nodes[i].name, target)) {
+			nodes[i].found = generation;
+			stack[nr++] = i;
+		}
+	}
+	while (nr) {
+		struct param_node *node = &nodes[stack[--nr]];
+
+		for (i = 0; i < node->nr_rev; i++) {
+			if (nodes[node->rev[i]].found == generation)
+				continue;
+			nodes[node->rev[i]].found = generation;
+			stack[nr++] = node->rev[i];
+		}
+	}
+	free(stack);
+
+	for (i = 0; i < nr_nodes; i++) {
+		char *s;
+
+		if (nodes[i].found != generation)
+			continue;
+		s = xstrndup(nodes[i].name, strlen(nodes[i].name));
+		*strrchr(s, '%') = ' ';
+		set_add(out, s, 1);
+	}
+}
+
+/*
+ * The tables.
+ */
+enum {
+	ALLOCATION_FUNCS,
+	BIT_SHIFTERS,
+	DMA_FUNCS,
+	RETURNS_ERR_PTR,
+	EXPECTS_ERR_PTR,
+	FREES_ARGUMENT,
+	GFP_FLAGS,
+	NO_RETURN_FUNCS,
+	PUTS_ARGUMENT,
+	RETURNS_HELD,
+	ROSENBERG_FUNCS,
+	SIZEOF_PARAM,
+	UNWIND_FUNCTIONS,
+	NR_TABLES,
+};
+
+struct table {
+	const char *name;
+	const char *remove;	/* defaults to the table name */
+	const char *header;
+	const char *script;
+	int kernel_only;
+	int uniq;		/* the script does "sort -u" before filtering */
+	struct str_set lines;
+};
+
+static struct table tables[NR_TABLES] = {
+	[ALLOCATION_FUNCS] = { "allocation_funcs", NULL,
+		"list of functions that return a new allocation.",
+		"gen_allocation_list.sh", 1, 1 },
+	[BIT_SHIFTERS] = { "bit_shifters", NULL,
+		"list of macros used as shifters.",
+		"gen_bit_shifters.sh", 0, 1 },
+	[DMA_FUNCS] = { "dma_funcs", NULL,
+		"list of DMA function and buffer parameters.",
+		"gen_dma_funcs.sh", 1, 1 },
+	[RETURNS_ERR_PTR] = { "returns_err_ptr", NULL,
+		"list of functions that return a new allocation.",
+		"gen_err_ptr_list.sh", 1, 1 },
+	[EXPECTS_ERR_PTR] = { "expects_err_ptr", NULL,
+		"list of functions which expect an ERR_PTR.",
+		"gen_expects_err_ptr.sh", 1, 1 },
+	[FREES_ARGUMENT] = { "frees_argument", NULL,
+		"list of functions and the argument they free.",
+		"gen_frees_list.sh", 1, 0 },
+	[GFP_FLAGS] = { "gfp_flags", NULL,
+		"list of GFP flag parameters.",
+		"gen_gfp_flags.sh", 1, 1 },
+	[NO_RETURN_FUNCS] = { "no_return_funcs", NULL,
+		"list of functions which don't return.",
+		"gen_no_return_funcs.sh", 0, 1 },
+	[PUTS_ARGUMENT] = { "puts_argument", NULL,
+		"list of functions and the argument they decrement the ref of.",
+		"gen_puts_list.sh", 1, 0 },
+	[RETURNS_HELD] = { "returns_held_funcs", "returns_held",
+		"list of functions that return a held device.",
+		"gen_returns_held.sh", 1, 1 },
+	[ROSENBERG_FUNCS] = { "rosenberg_funcs", NULL,
+		"list of copy_to_user function and buffer parameters.",
+		"gen_rosenberg_funcs.sh", 1, 1 },
+	[SIZEOF_PARAM] = { "sizeof_param", NULL,
+		"list of function parameters that are the size of a buffer.",
+		"gen_sizeof_param.sh", 0, 1 },
+	[UNWIND_FUNCTIONS] = { "unwind_functions", NULL,
+		"list of unwind functions.",
+		"gen_unwind_functions.sh", 1, 1 },
+};
+
+static int is_kernel;
+static FILE *implicit_deps, *write_lists;
+
+static void add_line(int table, char *str)
+{
+	set_add(&tables[table].lines, str, 1);
+}
+
+static void parse_line(char *line, size_t len)
+{
+	char *s;
+
+	if (strstr(line, "info: param_mapper "))
+		add_param_link(line);
+	if (strstr(line, "info: bit shifter")) {
+		s = strchr(line, '\'');
+		if (s) {
+			s = xstrndup(s + 1, strlen(s + 1));
+			delete_char(s, '\'');
+			add_line(BIT_SHIFTERS, s);
+		}
+	}
+	if (strstr(line, "no_return_funcs"))
+		add_line(NO_RETURN_FUNCS, function_name(line, 0));
+	if (strstr(line, "sizeof_param") && len >= 4 &&
+	    isdigit((unsigned char)line[len - 1]) &&
+	    ((line[len - 2] == ' ' && isdigit((unsigned char)line[len - 3])) ||
+	     (ends_with(line, len, " -1") && isdigit((unsigned char)line[len - 4]))))
+		add_line(SIZEOF_PARAM, cut(line, ' ', 5, 0, 0));
+
+	if (!is_kernel)
+		return;
+
+	if (ends_with(line, len, "allocation func"))
+		add_line(ALLOCATION_FUNCS, function_name(line, 1));
+	if (ends_with(line, len, "returns_err_ptr"))
+		add_line(RETURNS_ERR_PTR, function_name(line, 1));
+	if (strstr(line, "returned dev is held"))
+		add_line(RETURNS_HELD, function_name(line, 1));
+	if (strstr(line, "is unwind function"))
+		add_line(UNWIND_FUNCTIONS, function_name(line, 0));
+	if (has_word(line, "expects ERR_PTR")) {
+		char *two = cut(line, ' ', 2, 2, 0);
+		char *six = cut(line, ' ', 6, 6, 0);
+		regmatch_t m;
+		static regex_t param;
+		static int compiled;
+
+		if (!compiled++)
+			regcomp(&param, "\\([0-9]*\\)", REG_EXTENDED);
+
+		s = xmalloc(strlen(two) + strlen(six) + 2);
+		if (strchr(line, ' ') && *six)
+			sprintf(s, "%s %s", two, six);
+		else
+			strcpy(s, two);
+		if (regexec(&param, s, 1, &m, 0) == 0)
+			memmove(s + m.rm_so, s + m.rm_eo, strlen(s + m.rm_eo) + 1);
+		free(two);
+		free(six);
+		add_line(EXPECTS_ERR_PTR, s);
+	}
+	if (has_word(line, "free_arg"))
+		add_line(FREES_ARGUMENT, cut(line, ' ', 5, 0, 0));
+	if (has_word(line, "puts_arg"))
+		add_line(PUTS_ARGUMENT, cut(line, ' ', 5, 0, 0));
+	if (has_word(line, "read_list"))
+		fprintf(implicit_deps, "%s\n", line);
+	if (has_word(line, "write_list"))
+		fprintf(write_lists, "%s\n", line);
+}
+
+static char *data_file(const char *name, const char *suffix)
+{
+	char *path = xmalloc(strlen(data_dir) + strlen(project) + strlen(name) + strlen(suffix) + 4);
+
+	sprintf(path, "%s/%s.%s%s", data_dir, project, name, suffix);
+	return path;
+}
+
+static void copy_file(FILE *out, const char *path)
+{
+	char buf[4096];
+	size_t n;
+	FILE *in;
+
+	in = fopen(path, "r");
+	if (!in)
+		return;
+	while ((n = fread(buf, 1, sizeof(buf), in)) > 0)
+		fwrite(buf, 1, n, out);
+	fclose(in);
+}
+
+static void load_lines(struct str_set *set, const char *path)
+{
+	char *line = NULL;
+	size_t alloc = 0;
+	ssize_t len;
+	FILE *in;
+
+	in = fopen(path, "r");
+	if (!in)
+		return;
+	while ((len = getline(&line, &alloc, in)) >= 0) {
+		if (len && line[len - 1] == '\n')
+			line[--len] = '\0';
+		set_add(set, xstrndup(line, len), 1);
+	}
+	free(line);
+	fclose(in);
+}
+
+/* gen_sizeof_param.sh uses the .remove file as "grep -f" patterns */
+static int matches_any(regex_t *patterns, int nr, const char *str)
+{
+	int i;
+
+	for (i = 0; i < nr; i++) {
+		if (regexec(&patterns[i], str, 0, NULL, 0) == 0)
+			return 1;
+	}
+	return 0;
+}
+
+static int load_patterns(regex_t **patterns, const char *path)
+{
+	char *line = NULL;
+	size_t alloc = 0;
+	ssize_t len;
+	int nr = 0;
+	FILE *in;
+
+	*patterns = NULL;
+	in = fopen(path, "r");
+	if (!in)
+		return 0;
+	while ((len = getline(&line, &alloc, in)) >= 0) {
+		if (len && line[len - 1] == '\n')
+			line[--len] = '\0';
+		*patterns = xrealloc(*patterns, (nr + 1) * sizeof(regex_t));
+		if (regcomp(&(*patterns)[nr], line, REG_NOSUB) == 0)
+			nr++;
+	}
+	free(line);
+	fclose(in);
+	return nr;
+}
+
+/*
+ * "cat $tmp $remove $remove | sort | uniq -u": print the lines which
+ * were collected exactly once and are not in the remove list.
+ */
+static void write_table(int idx)
+{
+	struct table *t = &tables[idx];
+	struct str_set final = {}, remove = {};
+	struct str_entry *entries;
+	regex_t *patterns = NULL;
+	int nr_patterns = 0;
+	unsigned int i, nr = 0;
+	char *path, *out_name;
+	FILE *out;
+
+	if (t->kernel_only && !is_kernel)
+		return;
+
+	path = data_file(t->remove ? t->remove : t->name, ".remove");
+	if (idx == SIZEOF_PARAM)
+		nr_patterns = load_patterns(&patterns, path);
+	else
+		load_lines(&remove, path);
+	free(path);
+
+	for (i = 0; i < t->lines.size; i++) {
+		struct str_entry *e = &t->lines.table[i];
+		char *s;
+
+		if (!e->str)
+			continue;
+		s = e->str;
+		if (idx == SIZEOF_PARAM)
+			delete_char(s, '\'');
+		set_add(&final, s, t->uniq ? 1 : e->count);
+	}
+	free(t->lines.table);
+
+	if (idx == ALLOCATION_FUNCS) {
+		static const char *extra[] = { "kmalloc", "kzalloc", "kcalloc", "__alloc_skb" };
+
+		for (i = 0; i < sizeof(extra) / sizeof(extra[0]); i++)
+			set_add(&final, xstrndup(extra[i], strlen(extra[i])), 1);
+	}
+
+	entries = xmalloc((final.nr + 1) * sizeof(*entries));
+	for (i = 0; i < final.size; i++) {
+		struct str_entry *e = &final.table[i];
+
+		if (!e->str)
+			continue;
+		if (e->count == 1 && !set_contains(&remove, e->str) &&
+		    !matches_any(patterns, nr_patterns, e->str))
+			entries[nr++] = *e;
+	}
+	qsort(entries, nr, sizeof(*entries), cmp_entry);
+
+	out_name = xmalloc(strlen(project) + strlen(t->name) + 2);
+	sprintf(out_name, "%s.%s", project, t->name);
+	out = fopen(out_name, "w");
+	if (!out)
+		die("cannot write '%s'", out_name);
+	fprintf(out, "// %s\n", t->header);
+	fprintf(out, "// generated by `%s`\n", t->script);
+	if (idx == NO_RETURN_FUNCS) {
+		path = xmalloc(strlen(data_dir) + sizeof("/no_return_funcs"));
+		sprintf(path, "%s/no_return_funcs", data_dir);
+		copy_file(out, path);
+		free(path);
+		path = data_file(t->name, ".add");
+		copy_file(out, path);
+		free(path);
+	}
+	for (i = 0; i < nr; i++)
+		fprintf(out, "%s\n", entries[i].str);
+	fclose(out);
+	printf("Done.  List saved as '%s'\n", out_name);
+	free(out_name);
+	free(entries);
+}
+
+static void write_implicit_dependencies(void)
+{
+	char buf[4096];
+	size_t n;
+
+	rewind(write_lists);
+	while ((n = fread(buf, 1, sizeof(buf), write_lists)) > 0)
+		fwrite(buf, 1, n, implicit_deps);
+	fclose(write_lists);
+	fclose(implicit_deps);
+	printf("Done.  List saved as 'kernel.implicit_dependencies'\n");
+}
+
+static void usage(void)
+{
+	fprintf(stderr, "Usage:  gen_smatch_data [-p=<project>] [--data=<dir>] <file with smatch messages>\n");
+	exit(1);
+}
+
+/*
+ * Look for the data directory the way smatch does: ./smatch_data, then
+ * next to the binary, then the installed one.
+ */
+static const char *find_data_dir(const char *arg0)
+{
+	char *dir, *slash;
+
+	if (access("smatch_data", R_OK) == 0)
+		return "smatch_data";
+
+	slash = strrchr(arg0, '/');
+	if (slash) {
+		dir = xmalloc(slash - arg0 + sizeof("/smatch_data"));
+		sprintf(dir, "%.*s/smatch_data", (int)(slash - arg0), arg0);
+		if (access(dir, R_OK) == 0)
+			return dir;
+		free(dir);
+	}
+
+	if (access(SMATCHDATADIR "/smatch_data", R_OK) == 0)
+		return SMATCHDATADIR "/smatch_data";
+
+	die("no smatch_data directory here, next to the binary or in %s; use --data=<dir>", SMATCHDATADIR);
+	return NULL;
+}
+
+int main(int argc, char **argv)
+{
+	const char *file = NULL;
+	char *line = NULL;
+	size_t alloc = 0;
+	ssize_t len;
+	FILE *in;
+	int i;
+
+	for (i = 1; i < argc; i++) {
+		if (strncmp(argv[i], "-p=", 3) == 0)
+			project = argv[i] + 3;
+		else if (strncmp(argv[i], "--project=", 10) == 0)
+			project = argv[i] + 10;
+		else if (strncmp(argv[i], "--data=", 7) == 0)
+			data_dir = argv[i] + 7;
+		else if (argv[i][0] == '-' || file)
+			usage();
+		else
+			file = argv[i];
+	}
+	if (!file)
+		usage();
+
+	if (!data_dir)
+		data_dir = find_data_dir(argv[0]);
+	is_kernel = strcmp(project, "kernel") == 0;
+
+	in = fopen(file, "r");
+	if (!in)
+		die("cannot open '%s'", file);
+	if (is_kernel) {
+		implicit_deps = fopen("kernel.implicit_dependencies", "w");
+		write_lists = tmpfile();
+		if (!implicit_deps || !write_lists)
+			die("cannot write '%s'", "kernel.implicit_dependencies");
+	}
+
+	while ((len = getline(&line, &alloc, in)) >= 0) {
+		if (len && line[len - 1] == '\n')
+			line[--len] = '\0';
+		parse_line(line, len);
+	}
+	free(line);
+	fclose(in);
+
+	if (is_kernel) {
+		trace_param(&tables[DMA_FUNCS].lines, "usb_control_msg", 6);
+		trace_param(&tables[DMA_FUNCS].lines, "usb_fill_bulk_urb", 3);
+		trace_param(&tables[GFP_FLAGS].lines, "kmalloc", 1);
+		trace_param(&tables[GFP_FLAGS].lines, "kzalloc", 1);
+		trace_param(&tables[GFP_FLAGS].lines, "kcalloc", 2);
+		trace_param(&tables[ROSENBERG_FUNCS].lines, "copy_to_user", 1);
+		trace_param(&tables[ROSENBERG_FUNCS].lines, "nla_put", 3);
+	}
+
+	for (i = 0; i < NR_TABLES; i++)
+		write_table(i);
+	if (is_kernel)
+		write_implicit_dependencies();
+	return 0;
+}
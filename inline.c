@@ -72,6 +72,8 @@ static struct symbol_list *copy_symbol_list(struct symbol_list *src)
 	return dst;
 }
 
+static struct statement *copy_compound(struct position pos, struct statement *src);
+
 static struct expression * copy_expression(struct expression *expr)
 {
 	if (!expr)
@@ -191,8 +193,9 @@ static struct expression * copy_expression(struct expression *expr)
 
 	/* Statement expression */
 	case EXPR_STATEMENT: {
-		struct statement *stmt = alloc_statement(expr->pos, STMT_COMPOUND);
-		copy_statement(expr->statement, stmt);
+		struct statement *stmt = copy_compound(expr->pos, expr->statement);
+		if (stmt == expr->statement)
+			break;
 		expr = dup_expression(expr);
 		expr->statement = stmt;
 		break;
@@ -333,7 +336,20 @@ static struct statement *copy_one_statement(struct statement *stmt)
 		break;
 	case STMT_DECLARATION: {
 		struct symbol *sym;
-		struct statement *newstmt = dup_statement(stmt);
+		struct statement *newstmt;
+		int changed = 0;
+
+		/* declarations of only static/extern symbols can be shared */
+		FOR_EACH_PTR(stmt->declaration, sym) {
+			if (copy_symbol(stmt->pos, sym) != sym) {
+				changed = 1;
+				break;
+			}
+		} END_FOR_EACH_PTR(sym);
+		if (!changed)
+			break;
+
+		newstmt = dup_statement(stmt);
 		newstmt->declaration = NULL;
 		FOR_EACH_PTR(stmt->declaration, sym) {
 			struct symbol *newsym = copy_symbol(stmt->pos, sym);
@@ -361,12 +377,9 @@ static struct statement *copy_one_statement(struct statement *stmt)
 		stmt->range_expression = expr;
 		break;
 	}
-	case STMT_COMPOUND: {
-		struct statement *new = alloc_statement(stmt->pos, STMT_COMPOUND);
-		copy_statement(stmt, new);
-		stmt = new;
+	case STMT_COMPOUND:
+		stmt = copy_compound(stmt->pos, stmt);
 		break;
-	}
 	case STMT_IF: {
 		struct expression *cond = stmt->if_conditional;
 		struct statement *true = stmt->if_true;
@@ -480,6 +493,38 @@ void copy_statement(struct statement *src, struct statement *dst)
 	dst->inline_fn = src->inline_fn;
 }
 
+/*
+ * Like copy_statement(), but a block where nothing needs
+ * substituting is returned as is and shared, and the new
+ * STMT_COMPOUND is only allocated once we know it differs.
+ */
+static struct statement *copy_compound(struct position pos, struct statement *src)
+{
+	struct statement_list *stmts = NULL;
+	struct statement *stmt, *args, *dst;
+	struct symbol *ret;
+	int changed = 0;
+
+	FOR_EACH_PTR(src->stmts, stmt) {
+		struct statement *new = copy_one_statement(stmt);
+		changed |= new != stmt;
+		add_statement(&stmts, new);
+	} END_FOR_EACH_PTR(stmt);
+	args = copy_one_statement(src->args);
+	ret = copy_symbol(src->pos, src->ret);
+	if (!changed && args == src->args && ret == src->ret) {
+		free_ptr_list(&stmts);
+		return src;
+	}
+
+	dst = alloc_statement(pos, STMT_COMPOUND);
+	dst->stmts = stmts;
+	dst->args = args;
+	dst->ret = ret;
+	dst->inline_fn = src->inline_fn;
+	return dst;
+}
+
 static struct symbol *create_copy_symbol(struct symbol *orig)
 {
 	struct symbol *sym = orig;
@@ -506,6 +551,14 @@ static struct symbol_list *create_symbol_list(struct symbol_list *src)
 	return dst;
 }
 
+/*
+ * Each call gets its own copy of every node which mentions a parameter
+ * or a local of the inline function; only the rest is shared with
+ * fn->inline_stmt.  The body can't be shared through a per-call table
+ * of replacements instead: evaluation stores the types and implicit
+ * casts in the nodes and expansion folds the constant arguments into
+ * them in place, so two calls would overwrite each other.
+ */
 int inline_function(struct expression *expr, struct symbol *sym)
 {
 	struct symbol_list * fn_symbol_list;
@@ -561,6 +614,7 @@ int inline_function(struct expression *expr, struct symbol *sym)
 	stmt->inline_fn = sym;
 
 	unset_replace_list(fn_symbol_list);
+	free_ptr_list(&fn_symbol_list);
 
 	evaluate_statement(stmt);
 
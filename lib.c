@@ -261,6 +261,8 @@ int dump_macro_defs = 0;
 
 int dbg_entry = 0;
 int dbg_dead = 0;
+int dbg_ident = 0;
+int dbg_include = 0;
 
 int fmem_report = 0;
 int fdump_linearize;
@@ -603,6 +605,8 @@ static char **handle_switch_W(char *arg, char **next)
 static struct warning debugs[] = {
 	{ "entry", &dbg_entry},
 	{ "dead", &dbg_dead},
+	{ "ident", &dbg_ident},
+	{ "include", &dbg_include},
 };
 
 
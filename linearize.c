@@ -645,6 +645,8 @@ static void set_activeblock(struct entrypoint *ep, struct basic_block *bb)
 static void remove_parent(struct basic_block *child, struct basic_block *parent)
 {
 	remove_bb_from_list(&child->parents, parent, 1);
+	invalidate_dominators(parent->ep);
+	queue_bb(child);
 	if (!child->parents)
 		repeat_phase |= REPEAT_CFG_CLEANUP;
 }
@@ -843,9 +845,31 @@ pseudo_t alloc_phi(struct basic_block *source, pseudo_t pseudo, int size)
 	insn->bb = source;
 	insn->target = phi;
 	add_instruction(&source->insns, insn);
+	/* it's dead if the caller gives up on it */
+	queue_insn(insn);
 	return phi;
 }
 
+/*
+ * Add an empty phi-node at the start of "bb".  The SSA construction in
+ * flow.c fills in its sources once every phi-node has been placed.
+ */
+struct instruction *insert_phi_node(struct basic_block *bb, struct symbol *type)
+{
+	struct instruction *phi_node = alloc_typed_instruction(OP_PHI, type);
+	struct instruction *insn;
+
+	phi_node->pos = bb->pos;
+	phi_node->bb = bb;
+	phi_node->target = alloc_pseudo(phi_node);
+	FOR_EACH_PTR(bb->insns, insn) {
+		INSERT_CURRENT(phi_node, insn);
+		return phi_node;
+	} END_FOR_EACH_PTR(insn);
+	add_instruction(&bb->insns, phi_node);
+	return phi_node;
+}
+
 /*
  * We carry the "access_data" structure around for any accesses,
  * which simplifies things a lot. It contains all the access
@@ -2240,6 +2264,11 @@ static struct entrypoint *linearize_fn(struct symbol *sym, struct symbol *base_t
 	 */
 	simplify_symbol_usage(ep);
 
+	/*
+	 * From here on the passes queue what they change, and
+	 * cleanup_and_cse() only looks at that again.
+	 */
+	start_cleanup(ep);
 repeat:
 	/*
 	 * Remove trivial instructions, and try to CSE
@@ -2269,6 +2298,7 @@ repeat:
 		clear_liveness(ep);
 		goto repeat;
 	}
+	end_cleanup(ep);
 
 	/* Finally, add deathnotes to pseudos now that we have them */
 	if (dbg_dead)
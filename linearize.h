@@ -32,6 +32,7 @@ struct pseudo {
 	int nr;
 	int size:16;	/* OP_SETVAL only */
 	enum pseudo_type type:8;
+	int live_nr;	/* dense numbering, see track_pseudo_liveness() */
 	struct pseudo_user_list *users;
 	struct ident *ident;
 	union {
@@ -71,6 +72,7 @@ DECLARE_ALLOCATOR(asm_rules);
 struct instruction {
 	unsigned opcode:8,
 		 size:24;
+	unsigned int index;		/* position in bb, see simplify_symbol_usage() */
 	struct basic_block *bb;
 	struct position pos;
 	struct symbol *type;
@@ -232,6 +234,14 @@ struct basic_block {
 	struct basic_block_list *children; /* destinations */
 	struct instruction_list *insns;	/* Linear list of instructions */
 	struct pseudo_list *needs, *defines;
+	struct basic_block *idom;	/* immediate dominator */
+	unsigned long dom_generation;
+	unsigned long access_generation;	/* see mark_access_bbs() */
+	int postorder;
+	struct basic_block_list *frontier;	/* dominance frontier */
+	unsigned long ssa_generation;	/* see ssa_convert_symbol() */
+	struct instruction *ssa_store, *ssa_phi;
+	pseudo_t ssa_out;
 	union {
 		unsigned int nr;	/* unique id for label's names */
 		void *priv;
@@ -327,12 +337,14 @@ struct entrypoint {
 	struct basic_block_list *bbs;
 	struct basic_block *active;
 	struct instruction *entry;
+	unsigned long dom_generation;	/* when the dominator tree was built */
 };
 
 extern void insert_select(struct basic_block *bb, struct instruction *br, struct instruction *phi, pseudo_t if_true, pseudo_t if_false);
 extern void insert_branch(struct basic_block *bb, struct instruction *br, struct basic_block *target);
 
 pseudo_t alloc_phi(struct basic_block *source, pseudo_t pseudo, int size);
+struct instruction *insert_phi_node(struct basic_block *bb, struct symbol *type);
 pseudo_t alloc_pseudo(struct instruction *def);
 pseudo_t value_pseudo(struct symbol *type, long long val);
 unsigned int value_size(long long value);
@@ -6,11 +6,14 @@
  */
 
 #include <assert.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "parse.h"
 #include "expression.h"
 #include "linearize.h"
 #include "flow.h"
+#include "bitmap.h"
 
 static void phi_defines(struct instruction * phi_node, pseudo_t target,
 	void (*defines)(struct basic_block *, pseudo_t))
@@ -166,14 +169,10 @@ int pseudo_in_list(struct pseudo_list *list, pseudo_t pseudo)
 	return 0;
 }
 
-static int liveness_changed;
-
 static void add_pseudo_exclusive(struct pseudo_list **list, pseudo_t pseudo)
 {
-	if (!pseudo_in_list(*list, pseudo)) {
-		liveness_changed = 1;
+	if (!pseudo_in_list(*list, pseudo))
 		add_pseudo(list, pseudo);
-	}
 }
 
 static inline int trackable_pseudo(pseudo_t pseudo)
@@ -181,33 +180,189 @@ static inline int trackable_pseudo(pseudo_t pseudo)
 	return pseudo && (pseudo->type == PSEUDO_REG || pseudo->type == PSEUDO_ARG);
 }
 
+/*
+ * The fixpoint is computed on bitmaps: the pseudos which can be live
+ * across a block boundary are numbered densely and every block gets a
+ * "needs" and a "defines" bitmap indexed by that number.  Those are the
+ * arguments, the phis and the pseudos used outside of the block defining
+ * them; most pseudos are used right where they are defined and never get
+ * a number.  The needs inherited from the children only go in the
+ * bb->needs lists at the end, for the users of the liveness information.
+ *
+ * The bitmaps cost blocks * pseudos bits, so past LIVE_BITS_MAX words
+ * the fixpoint is done directly on the per-block pseudo lists instead:
+ * they only hold what each block actually needs.
+ */
+#define LIVE_BITS_MAX	(1 << 22)
+
+static pseudo_t *live_pseudos;
+static int nr_live_pseudos, max_live_pseudos;
+static unsigned long *live_bits;
+static int live_words;
+
+static inline int live_numbered(pseudo_t pseudo)
+{
+	int nr = pseudo->live_nr;
+
+	return nr < nr_live_pseudos && live_pseudos[nr] == pseudo;
+}
+
+static int live_nr(pseudo_t pseudo)
+{
+	if (live_numbered(pseudo))
+		return pseudo->live_nr;
+	if (nr_live_pseudos >= max_live_pseudos) {
+		max_live_pseudos = max_live_pseudos ? max_live_pseudos * 2 : 256;
+		live_pseudos = realloc(live_pseudos, max_live_pseudos * sizeof(pseudo_t));
+		if (!live_pseudos)
+			die("out of memory");
+	}
+	live_pseudos[nr_live_pseudos] = pseudo;
+	pseudo->live_nr = nr_live_pseudos;
+	return nr_live_pseudos++;
+}
+
+static inline unsigned long *bb_needs(struct basic_block *bb)
+{
+	return live_bits + (bb->postorder * 2) * live_words;
+}
+
+static inline unsigned long *bb_defines(struct basic_block *bb)
+{
+	return live_bits + (bb->postorder * 2 + 1) * live_words;
+}
+
+/* Does that use make "bb" need the pseudo from its parents? */
+static inline int use_needs(struct basic_block *bb, pseudo_t pseudo)
+{
+	struct instruction *def = pseudo->def;
+
+	return pseudo->type != PSEUDO_REG || def->bb != bb || def->opcode == OP_PHI;
+}
+
+static void number_use(struct basic_block *bb, pseudo_t pseudo)
+{
+	if (trackable_pseudo(pseudo) && use_needs(bb, pseudo))
+		live_nr(pseudo);
+}
+
+/* A pseudo no block needs doesn't have to be in the "defines" bitmaps */
+static void number_def(struct basic_block *bb, pseudo_t pseudo)
+{
+	assert(trackable_pseudo(pseudo));
+}
+
 static void insn_uses(struct basic_block *bb, pseudo_t pseudo)
 {
 	if (trackable_pseudo(pseudo)) {
-		struct instruction *def = pseudo->def;
-		if (pseudo->type != PSEUDO_REG || def->bb != bb || def->opcode == OP_PHI)
-			add_pseudo_exclusive(&bb->needs, pseudo);
+		if (use_needs(bb, pseudo)) {
+			int nr;
+
+			if (!live_bits) {
+				add_pseudo_exclusive(&bb->needs, pseudo);
+				return;
+			}
+			nr = live_nr(pseudo);
+
+			/* before the fixpoint, the needs are only the block's own */
+			if (!test_and_set_bit(nr, bb_needs(bb)))
+				add_pseudo(&bb->needs, pseudo);
+		}
 	}
 }
 
 static void insn_defines(struct basic_block *bb, pseudo_t pseudo)
 {
 	assert(trackable_pseudo(pseudo));
+	if (live_bits && live_numbered(pseudo))
+		set_bit(pseudo->live_nr, bb_defines(bb));
 	add_pseudo(&bb->defines, pseudo);
 }
 
-static void track_bb_liveness(struct basic_block *bb)
+/*
+ * Push the needs of "bb" up to its parents, and queue the parents whose
+ * needs grew.
+ */
+static void track_bb_liveness(struct basic_block *bb, unsigned char *queued,
+	struct basic_block **worklist, int *nr)
 {
-	pseudo_t needs;
+	unsigned long *needs = bb_needs(bb);
+	struct basic_block *parent;
 
-	FOR_EACH_PTR(bb->needs, needs) {
-		struct basic_block *parent;
-		FOR_EACH_PTR(bb->parents, parent) {
-			if (!pseudo_in_list(parent->defines, needs)) {
-				add_pseudo_exclusive(&parent->needs, needs);
-			}
-		} END_FOR_EACH_PTR(parent);
-	} END_FOR_EACH_PTR(needs);
+	FOR_EACH_PTR(bb->parents, parent) {
+		unsigned long *pneeds = bb_needs(parent);
+		unsigned long *pdefines = bb_defines(parent);
+		unsigned long grew = 0;
+		int i;
+
+		for (i = 0; i < live_words; i++) {
+			unsigned long add = needs[i] & ~pdefines[i] & ~pneeds[i];
+
+			pneeds[i] |= add;
+			grew |= add;
+		}
+		if (!grew)
+			continue;
+		if (!queued[parent->postorder]) {
+			queued[parent->postorder] = 1;
+			worklist[(*nr)++] = parent;
+		}
+	} END_FOR_EACH_PTR(parent);
+}
+
+/* The same, for when the needs are only kept in the bb->needs lists */
+static void track_bb_liveness_list(struct basic_block *bb, unsigned char *queued,
+	struct basic_block **worklist, int *nr)
+{
+	struct basic_block *parent;
+
+	FOR_EACH_PTR(bb->parents, parent) {
+		pseudo_t needs;
+		int grew = 0;
+
+		FOR_EACH_PTR(bb->needs, needs) {
+			if (pseudo_in_list(parent->defines, needs))
+				continue;
+			if (pseudo_in_list(parent->needs, needs))
+				continue;
+			add_pseudo(&parent->needs, needs);
+			grew = 1;
+		} END_FOR_EACH_PTR(needs);
+		if (!grew)
+			continue;
+		if (!queued[parent->postorder]) {
+			queued[parent->postorder] = 1;
+			worklist[(*nr)++] = parent;
+		}
+	} END_FOR_EACH_PTR(parent);
+}
+
+/*
+ * Append to bb->needs what the children need on top of what it already
+ * holds, the block's own uses, in pseudo order.  Those are taken out of
+ * the bitmap for that and put back after.
+ */
+static void add_inherited_needs(struct basic_block *bb, unsigned long *needs)
+{
+	pseudo_t pseudo;
+	int i;
+
+	FOR_EACH_PTR(bb->needs, pseudo) {
+		clear_bit(pseudo->live_nr, needs);
+	} END_FOR_EACH_PTR(pseudo);
+	for (i = 0; i < live_words; i++) {
+		unsigned long bits = needs[i];
+
+		while (bits) {
+			int bit = __builtin_ctzl(bits);
+
+			add_pseudo(&bb->needs, live_pseudos[i * BITS_IN_LONG + bit]);
+			bits &= bits - 1;
+		}
+	}
+	FOR_EACH_PTR(bb->needs, pseudo) {
+		set_bit(pseudo->live_nr, needs);
+	} END_FOR_EACH_PTR(pseudo);
 }
 
 /*
@@ -230,34 +385,82 @@ void clear_liveness(struct entrypoint *ep)
  */
 void track_pseudo_liveness(struct entrypoint *ep)
 {
-	struct basic_block *bb;
+	struct basic_block **order, **worklist, *bb;
+	unsigned char *queued;
+	int nr_bbs, reached, nr, i;
+
+	nr_bbs = postorder_bbs(ep, &order, &reached);
 
-	/* Add all the bb pseudo usage */
+	/* Number the pseudos.. */
+	nr_live_pseudos = 0;
 	FOR_EACH_PTR(ep->bbs, bb) {
 		struct instruction *insn;
 		FOR_EACH_PTR(bb->insns, insn) {
 			if (!insn->bb)
 				continue;
 			assert(insn->bb == bb);
+			track_instruction_usage(bb, insn, number_def, number_use);
+		} END_FOR_EACH_PTR(insn);
+	} END_FOR_EACH_PTR(bb);
+	live_words = (nr_live_pseudos + BITS_IN_LONG - 1) / BITS_IN_LONG;
+	live_bits = NULL;
+	if ((size_t)nr_bbs * 2 * live_words <= LIVE_BITS_MAX) {
+		live_bits = calloc((size_t)nr_bbs * 2 * live_words + 1, sizeof(unsigned long));
+		if (!live_bits)
+			die("out of memory");
+	}
+
+	/* ..add all the bb pseudo usage.. */
+	FOR_EACH_PTR(ep->bbs, bb) {
+		struct instruction *insn;
+		FOR_EACH_PTR(bb->insns, insn) {
+			if (!insn->bb)
+				continue;
 			track_instruction_usage(bb, insn, insn_defines, insn_uses);
 		} END_FOR_EACH_PTR(insn);
 	} END_FOR_EACH_PTR(bb);
 
-	/* Calculate liveness.. */
-	do {
-		liveness_changed = 0;
-		FOR_EACH_PTR_REVERSE(ep->bbs, bb) {
-			track_bb_liveness(bb);
-		} END_FOR_EACH_PTR_REVERSE(bb);
-	} while (liveness_changed);
+	/* ..and calculate liveness, children before parents */
+	worklist = malloc((nr_bbs + 1) * sizeof(*worklist));
+	queued = calloc(nr_bbs + 1, 1);
+	if (!worklist || !queued)
+		die("out of memory");
+	nr = 0;
+	for (i = reached - 1; i >= 0; i--) {
+		worklist[nr++] = order[i];
+		queued[i] = 1;
+	}
+	for (i = reached; i < nr_bbs; i++) {
+		worklist[nr++] = order[i];
+		queued[i] = 1;
+	}
+	while (nr) {
+		bb = worklist[--nr];
+		queued[bb->postorder] = 0;
+		if (live_bits)
+			track_bb_liveness(bb, queued, worklist, &nr);
+		else
+			track_bb_liveness_list(bb, queued, worklist, &nr);
+	}
+	free(worklist);
+	free(queued);
+
+	/* The needs inherited from the children go after the local ones */
+	if (live_bits) {
+		FOR_EACH_PTR(ep->bbs, bb) {
+			add_inherited_needs(bb, bb_needs(bb));
+		} END_FOR_EACH_PTR(bb);
+	}
 
-	/* Remove the pseudos from the "defines" list that are used internally */
 	FOR_EACH_PTR(ep->bbs, bb) {
 		pseudo_t def;
+
+		/* Remove the pseudos from the "defines" list that are used internally */
 		FOR_EACH_PTR(bb->defines, def) {
 			struct basic_block *child;
 			FOR_EACH_PTR(bb->children, child) {
-				if (pseudo_in_list(child->needs, def))
+				if (live_bits ? live_numbered(def) && test_bit(def->live_nr, bb_needs(child))
+					      : pseudo_in_list(child->needs, def))
 					goto is_used;
 			} END_FOR_EACH_PTR(child);
 			DELETE_CURRENT_PTR(def);
@@ -266,6 +469,9 @@ is_used:
 		} END_FOR_EACH_PTR(def);
 		PACK_PTR_LIST(&bb->defines);
 	} END_FOR_EACH_PTR(bb);
+
+	free(live_bits);
+	live_bits = NULL;
 }
 
 static void merge_pseudo_list(struct pseudo_list *src, struct pseudo_list **dest)
@@ -27,41 +27,85 @@
 #include <string.h>
 #include "lib.h"
 #include "parse.h"
-#include "cwchash/hashtable.h"
 
-static struct hashtable *macro_table;
+/*
+ * Expanded tokens inherit the position of the macro invocation, so the
+ * position is all we need to look up which macro a token came from.  The
+ * table is keyed on the packed (stream, line, pos) value rather than on a
+ * pointer into the token itself, which means the tokens can be freed once
+ * the file has been parsed.
+ */
+struct macro_pos {
+	unsigned long long key;
+	char *name;
+};
 
-static DEFINE_HASHTABLE_INSERT(do_insert_macro, struct position, char);
-static DEFINE_HASHTABLE_SEARCH(do_search_macro, struct position, char);
+static struct macro_pos *macro_table;
+static unsigned int macro_table_size;
+static unsigned int macro_count;
 
-static inline unsigned int position_hash(void *_pos)
+static inline unsigned long long pack_pos(struct position pos)
 {
-	struct position *pos = _pos;
+	return ((unsigned long long)pos.stream << 41) |
+	       ((unsigned long long)pos.line << 10) | pos.pos;
+}
 
-	return pos->line | (pos->pos << 22) | (pos->stream << 18); 
+static inline unsigned int hash_key(unsigned long long key)
+{
+	key *= 0x9e3779b97f4a7c15ULL;
+	return key >> 32;
 }
 
-static inline int equalkeys(void *_pos1, void *_pos2)
+static struct macro_pos *find_slot(struct macro_pos *table, unsigned int size,
+				   unsigned long long key)
 {
-	struct position *pos1 = _pos1;
-	struct position *pos2 = _pos2;
+	unsigned int mask = size - 1;
+	unsigned int i = hash_key(key) & mask;
 
-	return pos1->line == pos2->line && pos1->pos == pos2->pos &&
-		pos1->stream == pos2->stream;
+	while (table[i].name && table[i].key != key)
+		i = (i + 1) & mask;
+	return &table[i];
 }
 
-void store_macro_pos(struct token *token)
+static void grow_macro_table(void)
 {
+	struct macro_pos *old = macro_table;
+	unsigned int old_size = macro_table_size;
+	unsigned int i;
+
+	macro_table_size = old_size ? old_size * 2 : 8192;
+	macro_table = calloc(macro_table_size, sizeof(*macro_table));
 	if (!macro_table)
-		macro_table = create_hashtable(5000, position_hash, equalkeys);
+		die("out of memory for the macro table");
 
-	if (get_macro_name(token->pos))
+	for (i = 0; i < old_size; i++) {
+		if (old[i].name)
+			*find_slot(macro_table, macro_table_size, old[i].key) = old[i];
+	}
+	free(old);
+}
+
+void store_macro_pos(struct token *token)
+{
+	unsigned long long key = pack_pos(token->pos);
+	struct macro_pos *slot;
+
+	if (macro_count * 2 >= macro_table_size)
+		grow_macro_table();
+
+	/* Nested expansions share the position; the outermost macro wins */
+	slot = find_slot(macro_table, macro_table_size, key);
+	if (slot->name)
 		return;
 
-	do_insert_macro(macro_table, &token->pos, token->ident->name);
+	slot->key = key;
+	slot->name = token->ident->name;
+	macro_count++;
 }
 
 char *get_macro_name(struct position pos)
 {
-	return do_search_macro(macro_table, &pos);
+	if (!macro_table)
+		return NULL;
+	return find_slot(macro_table, macro_table_size, pack_pos(pos))->name;
 }
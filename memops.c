@@ -18,7 +18,7 @@
 
 static int find_dominating_parents(pseudo_t pseudo, struct instruction *insn,
 	struct basic_block *bb, unsigned long generation, struct pseudo_list **dominators,
-	int local)
+	int local, unsigned long access)
 {
 	struct basic_block *parent;
 
@@ -27,6 +27,8 @@ static int find_dominating_parents(pseudo_t pseudo, struct instruction *insn,
 		struct instruction *br;
 		pseudo_t phi;
 
+		if (access && parent->access_generation != access)
+			goto no_dominance;
 		FOR_EACH_PTR_REVERSE(parent->insns, one) {
 			int dominance;
 			if (!one->bb)
@@ -48,7 +50,7 @@ no_dominance:
 			continue;
 		parent->generation = generation;
 
-		if (!find_dominating_parents(pseudo, insn, parent, generation, dominators, local))
+		if (!find_dominating_parents(pseudo, insn, parent, generation, dominators, local, access))
 			return 0;
 		continue;
 
@@ -92,7 +94,7 @@ static void simplify_loads(struct basic_block *bb)
 			pseudo_t pseudo = insn->src;
 			int local = local_pseudo(pseudo);
 			struct pseudo_list *dominators;
-			unsigned long generation;
+			unsigned long generation, access;
 
 			/* Check for illegal offsets.. */
 			check_access(insn);
@@ -119,10 +121,11 @@ static void simplify_loads(struct basic_block *bb)
 			} END_FOR_EACH_PTR_REVERSE(dom);
 
 			/* OK, go find the parents */
+			access = local ? mark_access_bbs(pseudo) : 0;
 			generation = ++bb_generation;
 			bb->generation = generation;
 			dominators = NULL;
-			if (find_dominating_parents(pseudo, insn, bb, generation, &dominators, local)) {
+			if (find_dominating_parents(pseudo, insn, bb, generation, &dominators, local, access)) {
 				/* This happens with initial assignments to structures etc.. */
 				if (!dominators) {
 					if (local) {
@@ -132,6 +135,14 @@ static void simplify_loads(struct basic_block *bb)
 					goto next_load;
 				}
 				rewrite_load_instruction(insn, dominators);
+			} else {
+				pseudo_t phi;
+
+				/* drop the phi-sources found before giving up */
+				FOR_EACH_PTR(dominators, phi) {
+					kill_use(THIS_ADDRESS(phi));
+				} END_FOR_EACH_PTR(phi);
+				free_ptr_list(&dominators);
 			}
 		}
 next_load:
@@ -195,3 +206,31 @@ void simplify_memops(struct entrypoint *ep)
 		kill_dominated_stores(bb);
 	} END_FOR_EACH_PTR_REVERSE(bb);
 }
+
+/*
+ * The same, for the blocks on the list only.  The list is consumed; a
+ * block can be on it more than once.
+ */
+void simplify_memops_list(struct basic_block_list **list)
+{
+	unsigned long generation = ++bb_generation;
+	struct basic_block *bb;
+
+	FOR_EACH_PTR(*list, bb) {
+		if (!bb->ep || bb->generation == generation) {
+			DELETE_CURRENT_PTR(bb);
+			continue;
+		}
+		bb->generation = generation;
+	} END_FOR_EACH_PTR(bb);
+	PACK_PTR_LIST(list);
+
+	FOR_EACH_PTR_REVERSE(*list, bb) {
+		simplify_loads(bb);
+	} END_FOR_EACH_PTR_REVERSE(bb);
+
+	FOR_EACH_PTR_REVERSE(*list, bb) {
+		kill_dominated_stores(bb);
+	} END_FOR_EACH_PTR_REVERSE(bb);
+	free_ptr_list(list);
+}
@@ -31,6 +31,7 @@
 #include <stddef.h>
 #include <string.h>
 #include <ctype.h>
+#include <errno.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <limits.h>
@@ -168,6 +169,7 @@ static int expand_one_symbol(struct token **list)
 
 	sym = lookup_macro(token->ident);
 	if (sym) {
+		token->ident->seen = 1;
 		store_macro_pos(token);
 		sym->used_in = file_scope;
 		return expand(list, sym);
@@ -771,19 +773,15 @@ static int already_tokenized(const char *path)
 {
 	int stream, next;
 
-	for (stream = *hash_stream(path); stream >= 0 ; stream = next) {
+	/* every stream on this list is for the same file */
+	for (stream = find_stream(path); stream >= 0 ; stream = next) {
 		struct stream *s = input_streams + stream;
 
 		next = s->next_stream;
-		if (s->once) {
-			if (strcmp(path, s->name))
-				continue;
+		if (s->once)
 			return 1;
-		}
 		if (s->constant != CONSTANT_FILE_YES)
 			continue;
-		if (strcmp(path, s->name))
-			continue;
 		if (s->protect && !lookup_macro(s->protect))
 			continue;
 		return 1;
@@ -851,11 +849,95 @@ static void set_stream_include_path(struct stream *stream)
 	includepath[0] = path;
 }
 
+/*
+ * Every #include walks the include path and tries to open the header in
+ * each directory until one works.  With a long list of -I directories most
+ * of those opens fail, and they fail again each time the header is
+ * included, so the failed-open cache remembers the full names which don't
+ * exist.  The key is the resolved name, which already accounts for the
+ * include path in use, hashed with hash_path() like the stream names.
+ */
+#define FAILED_OPEN_BITS (9)
+
+struct failed_open {
+	const char *name;
+	unsigned int hash;
+	struct failed_open *next;
+};
+
+static struct failed_open **failed_opens;
+static unsigned int failed_opens_size, failed_opens_nr;
+static unsigned int include_lookups, include_opens, include_saved;
+
+static struct failed_open **failed_open_bucket(unsigned int hash)
+{
+	return &failed_opens[hash & (failed_opens_size - 1)];
+}
+
+static int open_failed_before(const char *name, unsigned int hash)
+{
+	struct failed_open *fail;
+
+	if (!failed_opens)
+		return 0;
+	for (fail = *failed_open_bucket(hash); fail; fail = fail->next) {
+		if (fail->hash == hash && strcmp(fail->name, name) == 0)
+			return 1;
+	}
+	return 0;
+}
+
+static void grow_failed_opens(void)
+{
+	struct failed_open **old = failed_opens;
+	unsigned int old_size = failed_opens_size;
+	struct failed_open *fail, *next, **bucket;
+	unsigned int i;
+
+	failed_opens_size = old_size ? old_size * 2 : 1 << FAILED_OPEN_BITS;
+	failed_opens = calloc(failed_opens_size, sizeof(*failed_opens));
+	if (!failed_opens)
+		die("Unable to allocate the failed-open cache");
+
+	for (i = 0; i < old_size; i++) {
+		for (fail = old[i]; fail; fail = next) {
+			next = fail->next;
+			bucket = failed_open_bucket(fail->hash);
+			fail->next = *bucket;
+			*bucket = fail;
+		}
+	}
+	free(old);
+}
+
+static void add_failed_open(const char *name, unsigned int hash)
+{
+	struct failed_open *fail, **bucket;
+
+	if (failed_opens_nr >= failed_opens_size)
+		grow_failed_opens();
+	failed_opens_nr++;
+
+	fail = malloc(sizeof(*fail));
+	fail->name = strdup(name);
+	fail->hash = hash;
+	bucket = failed_open_bucket(hash);
+	fail->next = *bucket;
+	*bucket = fail;
+}
+
+void show_include_stats(void)
+{
+	fprintf(stderr, "includes: %u lookups, %u opens, %u opens skipped by the failed-open cache (%u entries)\n",
+		include_lookups, include_opens, include_saved, failed_opens_nr);
+}
+
 static int try_include(const char *path, const char *filename, int flen, struct token **where, const char **next_path)
 {
 	int fd;
 	int plen = strlen(path);
 	static char fullname[PATH_MAX];
+	unsigned int hash;
 
 	memcpy(fullname, path, plen);
 	if (plen && path[plen-1] != '/') {
@@ -863,9 +945,18 @@ static int try_include(const char *path, const char *filename, int flen, struct
 		plen++;
 	}
 	memcpy(fullname+plen, filename, flen);
+	include_lookups++;
 	if (already_tokenized(fullname))
 		return 1;
+	hash = hash_path(fullname);
+	if (open_failed_before(fullname, hash)) {
+		include_saved++;
+		return 0;
+	}
+	include_opens++;
 	fd = open(fullname, O_RDONLY);
+	if (fd < 0 && (errno == ENOENT || errno == ENOTDIR))
+		add_failed_open(fullname, hash);
 	if (fd >= 0) {
 		char * streamname = __alloc_bytes(plen + flen);
 		memcpy(streamname, fullname, plen + flen);
@@ -187,6 +187,8 @@ out:
 static inline void remove_usage(pseudo_t p, pseudo_t *usep)
 {
 	if (has_use_list(p)) {
+		if (p->type == PSEUDO_REG)
+			queue_insn(p->def);
 		delete_pseudo_user_list_entry(&p->users, usep, 1);
 		if (!p->users)
 			kill_instruction(p->def);
@@ -1081,8 +1083,10 @@ static int simplify_branch(struct instruction *insn)
 	if (insn->bb_true == insn->bb_false) {
 		struct basic_block *bb = insn->bb;
 		struct basic_block *target = insn->bb_false;
+		invalidate_dominators(bb->ep);
 		remove_bb_from_list(&target->parents, bb, 1);
 		remove_bb_from_list(&bb->children, target, 1);
+		queue_bb(target);
 		insn->bb_false = NULL;
 		kill_use(&insn->cond);
 		insn->cond = NULL;
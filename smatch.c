@@ -28,6 +28,10 @@ enum project_type option_project = PROJ_NONE;
 char *bin_dir;
 char *data_dir;
 int option_no_data = 0;
+int option_compile_data;
+int option_merge_type_ranges;
+char *option_db_profile;
+static int option_summarize_caller_info;
 int option_spammy = 0;
 int option_info = 0;
 int option_full_path = 0;
@@ -133,6 +137,10 @@ static void help(void)
 	printf("--debug:  print lots of debug output.\n");
 	printf("--param-mapper:  enable param_mapper output.\n");
 	printf("--no-data:  do not use the /smatch_data/ directory.\n");
+	printf("--compile-data:  write smatch_data.bundle for the data directory.\n");
+	printf("--merge-type-ranges:  fill type_value and type_size in --db-file.\n");
+	printf("--summarize-caller-info[=fan_in]:  summarize the caller_info of functions with more than fan_in (200) callers.\n");
+	printf("--db-profile[=file]:  report the time and query plan of each database query.\n");
 	printf("--data=<dir>: overwrite path to default smatch data directory.\n");
 	printf("--full-path:  print the full pathname.\n");
 	printf("--debug-implied:  print debug output about implications.\n");
@@ -196,6 +204,26 @@ void parse_args(int *argcp, char ***argvp)
 			(*argvp)[1] = (*argvp)[0];
 			found = 1;
 		}
+		if (!found && !strcmp((*argvp)[1], "--db-profile")) {
+			option_db_profile = (char *)"";
+			(*argvp)[1] = (*argvp)[0];
+			found = 1;
+		}
+		if (!found && !strncmp((*argvp)[1], "--db-profile=", 13)) {
+			option_db_profile = (*argvp)[1] + 13;
+			(*argvp)[1] = (*argvp)[0];
+			found = 1;
+		}
+		if (!found && !strcmp((*argvp)[1], "--summarize-caller-info")) {
+			option_summarize_caller_info = 200;
+			(*argvp)[1] = (*argvp)[0];
+			found = 1;
+		}
+		if (!found && !strncmp((*argvp)[1], "--summarize-caller-info=", 24)) {
+			option_summarize_caller_info = atoi((*argvp)[1] + 24);
+			(*argvp)[1] = (*argvp)[0];
+			found = 1;
+		}
 		if (!found && !strncmp((*argvp)[1], "--data=", 7)) {
 			option_datadir_str = (*argvp)[1] + 7;
 			(*argvp)[1] = (*argvp)[0];
@@ -240,6 +268,8 @@ void parse_args(int *argcp, char ***argvp)
 		OPTION(time);
 		OPTION(mem);
 		OPTION(no_db);
+		OPTION(compile_data);
+		OPTION(merge_type_ranges);
 		if (!found)
 			break;
 		(*argcp)--;
@@ -330,6 +360,12 @@ int main(int argc, char **argv)
 
 	bin_dir = get_bin_dir(argv[0]);
 	data_dir = get_data_dir(argv[0]);
+	if (option_compile_data)
+		return compile_data_bundle();
+	if (option_merge_type_ranges)
+		return merge_type_ranges(option_db_file);
+	if (option_summarize_caller_info)
+		return summarize_caller_info(option_db_file, option_summarize_caller_info);
 
 	allocate_hook_memory();
 	create_function_hook_hash();
@@ -338,13 +374,20 @@ int main(int argc, char **argv)
 		func = reg_funcs[i].func;
 		/* The script IDs start at 1.
 		   0 is used for internal stuff. */
+		__registering_check = i;
 		if (!option_enable || reg_funcs[i].enabled == 1 ||
 		    (option_disable && reg_funcs[i].enabled != -1) ||
 		    strncmp(reg_funcs[i].name, "register_", 9) == 0)
 			func(i);
 	}
+	__registering_check = 0;
 
 	smatch(argc, argv);
+	db_profile_report();
+	if (dbg_ident)
+		show_identifier_stats();
+	if (dbg_include)
+		show_include_stats();
 	free_string(data_dir);
 	return 0;
 }
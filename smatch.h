@@ -146,7 +146,11 @@ enum hook_type {
 
 struct range_list;
 
+extern int __registering_check;
 void add_hook(void *func, enum hook_type type);
+void add_expr_type_hook(void *func, enum expression_type expr_type);
+void add_op_hook(void *func, enum hook_type type, int op);
+void add_check_trigger(int owner, const char *name);
 typedef struct smatch_state *(merge_func_t)(struct smatch_state *s1, struct smatch_state *s2);
 typedef struct smatch_state *(unmatched_func_t)(struct sm_state *state);
 void add_merge_hook(int client_id, merge_func_t *func);
@@ -699,6 +703,7 @@ struct smatch_state *__client_unmatched_state_function(struct sm_state *sm);
 void call_pre_merge_hook(struct sm_state *sm);
 void __push_scope_hooks(void);
 void __call_scope_hooks(void);
+void __select_active_checks(void);
 
 /* smatch_function_hooks.c */
 void create_function_hook_hash(void);
@@ -773,8 +778,6 @@ enum info_type {
 };
 
 extern struct sqlite3 *smatch_db;
-extern struct sqlite3 *mem_db;
-extern struct sqlite3 *cache_db;
 
 void debug_sql(struct sqlite3 *db, const char *sql);
 void db_ignore_states(int id);
@@ -817,37 +820,16 @@ do {										\
 	sql_helper(smatch_db, call_back, data, sql);				\
 } while (0)
 
-#define mem_sql(call_back, data, sql...)					\
-	sql_helper(mem_db, call_back, data, sql)
-
-#define cache_sql(call_back, data, sql...)					\
-	sql_helper(cache_db, call_back, data, sql)
-
-#define sql_insert_helper(table, db, ignore, late, values...)			\
+/*
+ * Inline functions are only summarized for their callers in the same file.
+ * The tables which are read back (return_states, return_implies, caller_info)
+ * are saved to the mem_* tables by their sql_insert_*() functions and the rest
+ * are thrown away.
+ */
+#define sql_insert_helper(table, ignore, late, values...)			\
 do {										\
-	struct sqlite3 *_db = db;						\
-										\
-	if (__inline_fn && !_db)						\
-		_db = mem_db;							\
-	if (_db) {								\
-		char buf[1024];							\
-		char *err, *p = buf;						\
-		int rc;								\
-										\
-		p += snprintf(p, buf + sizeof(buf) - p,				\
-			      "insert %sinto %s values (",			\
-			      ignore ? "or ignore " : "", #table);		\
-		p += snprintf(p, buf + sizeof(buf) - p, values);		\
-		p += snprintf(p, buf + sizeof(buf) - p, ");");			\
-		sm_debug("mem-db: %s\n", buf);					\
-		rc = sqlite3_exec(_db, buf, NULL, NULL, &err);			\
-		if (rc != SQLITE_OK) {						\
-			fprintf(stderr, "SQL error #2: %s\n", err);		\
-			fprintf(stderr, "SQL: '%s'\n", buf);			\
-			parse_error = 1;					\
-		}								\
+	if (__inline_fn && mem_db_open)						\
 		break;								\
-	}									\
 	if (option_info) {							\
 		FILE *tmp_fd = sm_outfd;					\
 		sm_outfd = sql_outfd;						\
@@ -860,10 +842,9 @@ do {										\
 	}									\
 } while (0)
 
-#define sql_insert(table, values...) sql_insert_helper(table, 0, 0, 0, values);
-#define sql_insert_or_ignore(table, values...) sql_insert_helper(table, 0, 1, 0, values);
-#define sql_insert_late(table, values...) sql_insert_helper(table, 0, 0, 1, values);
-#define sql_insert_cache(table, values...) sql_insert_helper(table, cache_db, 1, 0, values);
+#define sql_insert(table, values...) sql_insert_helper(table, 0, 0, values);
+#define sql_insert_or_ignore(table, values...) sql_insert_helper(table, 1, 0, values);
+#define sql_insert_late(table, values...) sql_insert_helper(table, 0, 1, values);
 
 char *get_static_filter(struct symbol *sym);
 
@@ -902,10 +883,43 @@ void sql_select_call_implies(const char *cols, struct expression *call,
 
 void open_smatch_db(char *db_file);
 
+/* smatch_mem_db.c */
+struct mem_table;
+extern int mem_db_open;
+extern struct mem_table *mem_caller_info;
+extern struct mem_table *mem_return_states;
+extern struct mem_table *mem_return_implies;
+extern struct mem_table *mem_call_implies;
+extern struct mem_table *mem_local_values;
+extern struct mem_table *mem_mtag_data;
+extern struct mem_table *cache_type_info;
+extern struct mem_table *cache_mtag_data;
+extern struct mem_table *cache_sink_info;
+
+struct mem_table *alloc_mem_table(const char *name, const char *columns,
+				  const char *key, const char *unique);
+void mem_insert(struct mem_table *table, const char *fmt, ...);
+void mem_delete(struct mem_table *table, const char *where, ...);
+void mem_select(struct mem_table *table, const char *cols, const char *order,
+		int (*callback)(void*, int, char**, char**), void *data,
+		const char *where, ...);
+void init_mem_db(void);
+
+/* smatch_db_merge.c */
+int merge_type_ranges(const char *db_file);
+int summarize_caller_info(const char *db_file, int fan_in);
+
+/* smatch_db_profile.c */
+int db_profile_exec(struct sqlite3 *db, const char *sql,
+		    int (*callback)(void*, int, char**, char**), void *data,
+		    char **err);
+void db_profile_report(void);
+
 /* smatch_files.c */
 int open_data_file(const char *filename);
 int open_schema_file(const char *schema);
 struct token *get_tokens_file(const char *filename);
+int compile_data_bundle(void);
 
 /* smatch.c */
 extern char *option_debug_check;
@@ -913,6 +927,9 @@ extern char *option_project_str;
 extern char *bin_dir;
 extern char *data_dir;
 extern int option_no_data;
+extern int option_compile_data;
+extern int option_merge_type_ranges;
+extern char *option_db_profile;
 extern int option_full_path;
 extern int option_param_mapper;
 extern int option_call_tree;
@@ -143,17 +143,16 @@ static struct range_list *get_saved_rl(struct symbol *type, char *name)
 {
 	struct db_info db_info = {.type = type};
 
-	cache_sql(&get_vals, &db_info, "select value from sink_info where sink_name = '%s' and type = %d;",
-		  name, DATA_VALUE);
+	mem_select(cache_sink_info, "value", NULL, &get_vals, &db_info,
+		   "sink_name = %s and type = %d", name, DATA_VALUE);
 	return db_info.rl;
 }
 
 static void update_cache(char *name, int is_static, struct range_list *rl)
 {
-	cache_sql(NULL, NULL, "delete from sink_info where sink_name = '%s' and type = %d;",
-		  name, DATA_VALUE);
-	cache_sql(NULL, NULL, "insert into sink_info values ('%s', %d, '%s', %d, '', '%s');",
-		  get_filename(), is_static, name, DATA_VALUE, show_rl(rl));
+	mem_delete(cache_sink_info, "sink_name = %s and type = %d", name, DATA_VALUE);
+	mem_insert(cache_sink_info, "%s %d %s %d %s %s",
+		   get_filename(), is_static, name, DATA_VALUE, "", show_rl(rl));
 }
 
 static void match_assign(struct expression *expr)
@@ -588,8 +588,10 @@ void register_buf_comparison(int id)
 		add_allocation_function("krealloc", &match_alloc, 1);
 	}
 
-	add_hook(&array_check, OP_HOOK);
-	add_hook(&array_check_data_info, OP_HOOK);
+	add_op_hook(&array_check, OP_HOOK, '*');
+	add_op_hook(&array_check, OP_HOOK, '(');
+	add_op_hook(&array_check_data_info, OP_HOOK, '*');
+	add_op_hook(&array_check_data_info, OP_HOOK, '(');
 
 	add_hook(&match_call, FUNCTION_CALL_HOOK);
 	select_caller_info_hook(set_param_compare, ARRAY_LEN);
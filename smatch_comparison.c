@@ -2504,7 +2504,8 @@ void register_comparison(int id)
 	add_split_return_callback(&print_return_comparison);
 
 	select_return_states_hook(PARAM_COMPARE, &db_return_comparison);
-	add_hook(&match_preop, OP_HOOK);
+	add_op_hook(&match_preop, OP_HOOK, SPECIAL_INCREMENT);
+	add_op_hook(&match_preop, OP_HOOK, SPECIAL_DECREMENT);
 }
 
 void register_comparison_late(int id)
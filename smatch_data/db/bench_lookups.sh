@@ -0,0 +1,39 @@
+#!/bin/bash
+
+#
+# Time the return_states and caller_info lookups which smatch does for
+# every function call against a database.  Useful for comparing the
+# normal layout with the one from cluster_tables.sh.
+#
+
+db_file=$1
+nr=${2:-2000}
+
+if [ "$db_file" = "" ] ; then
+    echo "usage:  $0 <db_file> [nr of lookups]"
+    exit 1
+fi
+
+queries=$(mktemp)
+
+echo "select function, static, file from (select distinct function, static, file from return_states) order by random() limit $nr;" | \
+    sqlite3 -separator ' ' $db_file | \
+while read func static file ; do
+    if [ "$static" = "1" ] ; then
+        filter="file = '$file' and function = '$func' and static = '1'"
+    else
+        filter="function = '$func' and static = '0'"
+    fi
+    echo "select return_id, return, type, parameter, key, value from return_states where $filter order by file, return_id, type;"
+    echo "select call_id, type, parameter, key, value from caller_info where $filter order by call_id;"
+done > $queries
+
+lookups=$(grep -c . $queries)
+start=$(date +%s%N)
+sqlite3 $db_file < $queries > /dev/null
+end=$(date +%s%N)
+rm -f $queries
+
+usec=$(((end - start) / 1000))
+[ $usec -eq 0 ] && usec=1
+echo "$db_file: $(stat -c %s $db_file) bytes, $lookups lookups in $((usec / 1000))ms, $((lookups * 1000000 / usec)) lookups/sec"
@@ -0,0 +1,88 @@
+#!/bin/bash
+
+db_file=$1
+threads=${2:-4}
+
+#
+# smdb.py walks the call tree one function at a time.  These tables hold
+# what it needs so that each step is a single indexed lookup instead of a
+# scan of every caller_info row for a function.
+#
+# fn_ptr_closure:  every function pointer a function can be called
+#                  through, following pointers which are assigned to
+#                  other pointers.
+# call_edges:      one row per caller -> function (or pointer) pair.
+# param_trace:     the caller_info rows which trace_param follows, in
+#                  the original order.
+#
+
+pragmas="PRAGMA synchronous = OFF;
+PRAGMA cache_size = 800000;
+PRAGMA journal_mode = OFF;
+PRAGMA count_changes = OFF;
+PRAGMA temp_store = MEMORY;
+PRAGMA locking = EXCLUSIVE;
+PRAGMA threads = $threads;"
+
+cat << EOF | sqlite3 $db_file > /dev/null
+$pragmas
+
+DROP TABLE IF EXISTS fn_ptr_closure;
+DROP TABLE IF EXISTS call_edges;
+DROP TABLE IF EXISTS param_trace;
+
+BEGIN;
+
+CREATE TABLE fn_ptr_closure (function varchar(64), ptr varchar(256), depth integer);
+INSERT INTO fn_ptr_closure SELECT DISTINCT function, ptr, 1 FROM function_ptr;
+
+CREATE TABLE call_edges (caller varchar(64), function varchar(64));
+INSERT INTO call_edges SELECT DISTINCT caller, function FROM caller_info;
+
+CREATE TABLE param_trace (function varchar(64), parameter integer, type integer, caller varchar(64), value varchar(256));
+INSERT INTO param_trace
+    SELECT function, parameter, type, caller, value FROM caller_info
+    WHERE type = 0 or type = 1014 or type = 1028 ORDER BY rowid;
+
+COMMIT;
+
+CREATE UNIQUE INDEX fn_ptr_closure_pair on fn_ptr_closure (function, ptr);
+CREATE INDEX fn_ptr_closure_idx on fn_ptr_closure (depth, function);
+
+EOF
+
+#
+# Add the pointers which are one more assignment away, a level at a time.
+# A (function, ptr) pair is only stored once, at the depth where it is
+# first reached, so cycles in function_ptr end the loop by themselves and
+# there is no depth limit.
+#
+depth=1
+while true ; do
+    added=$(cat << EOF | sqlite3 $db_file
+$pragmas
+INSERT OR IGNORE INTO fn_ptr_closure
+    SELECT closure.function, function_ptr.ptr, closure.depth + 1
+        FROM fn_ptr_closure AS closure
+        JOIN function_ptr ON function_ptr.function = closure.ptr
+        WHERE closure.depth = $depth;
+SELECT changes();
+EOF
+)
+    added=$(echo "$added" | tail -n 1)
+    if [ "$added" = "0" ] || [ "$added" = "" ] ; then
+        break
+    fi
+    depth=$((depth + 1))
+done
+
+cat << EOF | sqlite3 $db_file > /dev/null
+$pragmas
+
+DROP INDEX fn_ptr_closure_idx;
+CREATE INDEX fn_ptr_closure_idx on fn_ptr_closure (function, depth);
+CREATE INDEX call_edges_idx on call_edges (function);
+CREATE INDEX call_edges_caller_idx on call_edges (caller);
+CREATE INDEX param_trace_idx on param_trace (function);
+
+EOF
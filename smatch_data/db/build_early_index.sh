@@ -1,15 +1,17 @@
 #!/bin/bash
 
 db_file=$1
+threads=${2:-4}
 
 
-cat << EOF | sqlite3 $db_file
+cat << EOF | sqlite3 $db_file > /dev/null
 PRAGMA synchronous = OFF;
 PRAGMA cache_size = 800000;
 PRAGMA journal_mode = OFF;
 PRAGMA count_changes = OFF;
 PRAGMA temp_store = MEMORY;
 PRAGMA locking = EXCLUSIVE;
+PRAGMA threads = $threads;
 
 CREATE INDEX caller_fn_idx on caller_info (function, call_id);
 CREATE INDEX caller_ff_idx on caller_info (file, function, call_id);
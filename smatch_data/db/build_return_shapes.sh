@@ -0,0 +1,79 @@
+#!/bin/bash
+
+db_file=$1
+threads=${2:-4}
+
+if [ "$db_file" = "" ] ; then
+    echo "usage:  $0 <db_file> [threads]"
+    exit 1
+fi
+
+#
+# Many functions have exactly the same return_states rows apart from the
+# file and function name, for example wrappers and the different copies
+# of a function that get built for each config.  Store each distinct set
+# of rows once in return_shapes and point to it from return_fns.
+#
+# return_states becomes a view over the two tables so the queries which
+# use it keep working.  smatch notices return_fns and caches the rows of
+# each shape it has loaded.
+#
+# return_id comes from a counter which runs over the whole translation
+# unit so it is renumbered from 1 inside each function.  call_id is the
+# inline function it was recorded for and doesn't say anything about the
+# function either so it is left out.  Then the rows of a function are
+# joined into one string in (return_id, type, rowid) order to compare
+# them, and the rows of the first function with that string are copied.
+#
+
+cat << EOF | sqlite3 $db_file > /dev/null
+PRAGMA synchronous = OFF;
+PRAGMA cache_size = 800000;
+PRAGMA journal_mode = OFF;
+PRAGMA temp_store = MEMORY;
+PRAGMA locking = EXCLUSIVE;
+PRAGMA threads = $threads;
+
+BEGIN;
+
+CREATE TEMP TABLE fn_rows AS
+    SELECT rowid AS row, file, function, static, call_id,
+        dense_rank() OVER (PARTITION BY file, function, static ORDER BY return_id) AS return_id,
+        return, type, parameter, key, value
+    FROM return_states;
+
+CREATE TEMP TABLE fn_body AS
+    SELECT file, function, static,
+        group_concat(return_id || char(1) || return || char(1) || type || char(1) || parameter || char(1) || key || char(1) || value, char(2)) AS body
+    FROM (SELECT * FROM fn_rows ORDER BY file, function, static, return_id, type, row)
+    GROUP BY file, function, static;
+
+CREATE TEMP TABLE shape_body (shape integer primary key, body text unique);
+INSERT OR IGNORE INTO shape_body (body) SELECT body FROM fn_body ORDER BY file, function, static;
+
+CREATE TABLE return_fns (file varchar(128), function varchar(64), static boolean, shape integer);
+INSERT INTO return_fns
+    SELECT fn_body.file, fn_body.function, fn_body.static, shape_body.shape
+    FROM fn_body JOIN shape_body ON fn_body.body = shape_body.body;
+
+CREATE TABLE return_shapes (shape integer, call_id integer, return_id integer, return varchar(256), type integer, parameter integer, key varchar(256), value varchar(256));
+INSERT INTO return_shapes
+    SELECT first.shape, call_id, return_id, return, type, parameter, key, value
+    FROM (SELECT shape, min(rowid), file, function, static FROM return_fns GROUP BY shape) AS first
+    JOIN fn_rows ON fn_rows.file = first.file and fn_rows.function = first.function and fn_rows.static = first.static
+    ORDER BY first.shape, return_id, type, fn_rows.row;
+
+DROP TABLE return_states;
+CREATE VIEW return_states AS
+    SELECT return_fns.file, return_fns.function, return_shapes.call_id, return_id, return, return_fns.static, type, parameter, key, value
+    FROM return_fns JOIN return_shapes ON return_fns.shape = return_shapes.shape;
+
+COMMIT;
+
+CREATE INDEX return_fns_fn_idx on return_fns (function, static);
+CREATE INDEX return_fns_ff_idx on return_fns (file, function);
+CREATE INDEX return_shapes_idx on return_shapes (shape, return_id, type);
+
+VACUUM;
+
+EOF
@@ -0,0 +1,78 @@
+#!/bin/bash
+
+db_file=$1
+threads=${2:-4}
+
+if [ "$db_file" = "" ] ; then
+    echo "usage:  $0 <db_file> [threads]"
+    exit 1
+fi
+
+#
+# Rebuild return_states, caller_info and common_caller_info as WITHOUT
+# ROWID tables clustered on the columns smatch_db.c looks them up by, so
+# that a lookup reads one range of the table already in "order by" order
+# instead of probing an index and then fetching each row.
+#
+# The primary key has to be unique so the old rowid is kept as a "seq"
+# column at the end.  It also keeps rows with the same key in the order
+# they were inserted.  Inserting with "values (...)" no longer works
+# after this, so reload_partial.sh can't be used on these databases.
+#
+# Dropping the old tables drops their indexes too.  The primary keys
+# cover the lookups by function, but for caller_info and
+# common_caller_info a static function is looked up by file as well and
+# the primary key doesn't have the file, so the (file, function,
+# call_id) indexes from build_early_index.sh are created again.  Without
+# statistics sqlite prefers the primary key even for those lookups and
+# then reads the callers of every static function with the same name, so
+# the two tables are analyzed.
+#
+
+# with --shared-returns return_states is a view and is left alone
+return_states=""
+if [ "$(echo "select type from sqlite_master where name = 'return_states';" | sqlite3 $db_file)" = "table" ] ; then
+    return_states="
+CREATE TABLE return_states_clustered (file varchar(128), function varchar(64), call_id integer, return_id integer, return varchar(256), static boolean, type integer, parameter integer, key varchar(256), value varchar(256), seq integer,
+    PRIMARY KEY (function, static, file, return_id, type, seq)) WITHOUT ROWID;
+INSERT INTO return_states_clustered SELECT *, rowid FROM return_states;
+DROP TABLE return_states;
+ALTER TABLE return_states_clustered RENAME TO return_states;"
+fi
+
+cat << EOF | sqlite3 $db_file > /dev/null
+PRAGMA synchronous = OFF;
+PRAGMA cache_size = 800000;
+PRAGMA journal_mode = OFF;
+PRAGMA temp_store = MEMORY;
+PRAGMA locking = EXCLUSIVE;
+PRAGMA threads = $threads;
+
+BEGIN;
+
+$return_states
+
+CREATE TABLE caller_info_clustered (file varchar(128), caller varchar(64), function varchar(64), call_id integer, static boolean, type integer, parameter integer, key varchar(256), value varchar(256), seq integer,
+    PRIMARY KEY (function, static, call_id, seq)) WITHOUT ROWID;
+INSERT INTO caller_info_clustered SELECT *, rowid FROM caller_info;
+DROP TABLE caller_info;
+ALTER TABLE caller_info_clustered RENAME TO caller_info;
+
+CREATE TABLE common_caller_info_clustered (file varchar(128), caller varchar(64), function varchar(64), call_id integer, static boolean, type integer, parameter integer, key varchar(256), value varchar(256), seq integer,
+    PRIMARY KEY (function, static, call_id, seq)) WITHOUT ROWID;
+INSERT INTO common_caller_info_clustered SELECT *, rowid FROM common_caller_info;
+DROP TABLE common_caller_info;
+ALTER TABLE common_caller_info_clustered RENAME TO common_caller_info;
+
+CREATE INDEX caller_ff_idx on caller_info (file, function, call_id);
+CREATE INDEX common_ff_idx on common_caller_info (file, function, call_id);
+
+COMMIT;
+
+PRAGMA analysis_limit = 1000;
+ANALYZE caller_info;
+ANALYZE common_caller_info;
+
+VACUUM;
+
+EOF
@@ -1,58 +1,177 @@
 #!/bin/bash
 
-if echo $1 | grep -q '^-p' ; then
-    PROJ=$(echo $1 | cut -d = -f 2)
+while echo $1 | grep -q '^-' ; do
+    if echo $1 | grep -q '^-p' ; then
+        PROJ=$(echo $1 | cut -d = -f 2)
+    elif [ "$1" = "--clustered" ] ; then
+        clustered=1
+    elif [ "$1" = "--shared-returns" ] ; then
+        shared_returns=1
+    elif echo $1 | grep -q '^--fan-in=' ; then
+        fan_in=$(echo $1 | cut -d = -f 2)
+    else
+        break
+    fi
     shift
-fi
+done
 
 info_file=$1
 
 if [[ "$info_file" = "" ]] ; then
-    echo "Usage:  $0 -p=<project> <file with smatch messages>"
+    echo "Usage:  $0 [--clustered] [--shared-returns] [--fan-in=<callers>] -p=<project> <file with smatch messages>"
     exit 1
 fi
 
 bin_dir=$(dirname $0)
 db_file=smatch_db.sqlite.new
+caller_db=smatch_db.caller_info.new
+threads=$(nproc 2> /dev/null || echo 4)
+fan_in=${fan_in:-200}
 
-rm -f $db_file
+# run "$@" and print how long it took as stage "$1"
+stage()
+{
+    local name=$1
+    local start=$(date +%s%N)
+    local end ret
+    shift
 
-for i in ${bin_dir}/*.schema ; do
-    cat $i | sqlite3 $db_file
-done
+    "$@"
+    ret=$?
+    end=$(date +%s%N)
+    printf "create_db: %-20s %4d.%03ds\n" $name $(((end - start) / 1000000000)) \
+        $((((end - start) / 1000000) % 1000)) >&2
+    return $ret
+}
 
-${bin_dir}/init_constraints.pl "$PROJ" $info_file $db_file
-${bin_dir}/init_constraints_required.pl "$PROJ" $info_file $db_file
-${bin_dir}/fill_db_sql.pl "$PROJ" $info_file $db_file
-if [ -e ${info_file}.sql ] ; then
-    ${bin_dir}/fill_db_sql.pl "$PROJ" ${info_file}.sql $db_file
-fi
-${bin_dir}/fill_db_caller_info.pl "$PROJ" $info_file $db_file
-if [ -e ${info_file}.caller_info ] ; then
-    ${bin_dir}/fill_db_caller_info.pl "$PROJ" ${info_file}.caller_info $db_file
-fi
-${bin_dir}/build_early_index.sh $db_file
+# run a stage and give up on the whole database if it fails
+must()
+{
+    if ! stage "$@" ; then
+        echo "$0: stage $1 failed" >&2
+        rm -f $db_file $caller_db
+        exit 1
+    fi
+}
 
-${bin_dir}/fill_db_type_value.pl "$PROJ" $info_file $db_file
-${bin_dir}/fill_db_type_size.pl "$PROJ" $info_file $db_file
-${bin_dir}/copy_required_constraints.pl "$PROJ" $info_file $db_file
-${bin_dir}/build_late_index.sh $db_file
+create_schema()
+{
+    for i in ${bin_dir}/*.schema ; do
+        cat $i | sqlite3 $db_file || return 1
+    done
 
-${bin_dir}/fixup_all.sh $db_file
-if [ "$PROJ" != "" ] ; then
-    ${bin_dir}/fixup_${PROJ}.sh $db_file
-fi
+    cat ${bin_dir}/caller_info.schema ${bin_dir}/common_caller_info.schema | \
+        sqlite3 $caller_db || return 1
+}
 
-${bin_dir}/remove_mixed_up_pointer_params.pl $db_file
-${bin_dir}/mark_function_ptrs_searchable.pl $db_file
+fill_main()
+{
+    ${bin_dir}/init_constraints.pl "$PROJ" $info_file $db_file || return 1
+    ${bin_dir}/init_constraints_required.pl "$PROJ" $info_file $db_file || return 1
+    ${bin_dir}/fill_db_sql.pl "$PROJ" $info_file $db_file || return 1
+    if [ -e ${info_file}.sql ] ; then
+        ${bin_dir}/fill_db_sql.pl "$PROJ" ${info_file}.sql $db_file || return 1
+    fi
+}
 
-# delete duplicate entrees and speed things up
-echo "delete from function_ptr where rowid not in (select min(rowid) from function_ptr group by file, function, ptr, searchable);" | sqlite3 $db_file
+fill_caller_info()
+{
+    ${bin_dir}/fill_db_caller_info.pl "$PROJ" $info_file $caller_db || return 1
+    if [ -e ${info_file}.caller_info ] ; then
+        ${bin_dir}/fill_db_caller_info.pl "$PROJ" ${info_file}.caller_info $caller_db || return 1
+    fi
+}
 
-test -e  ${bin_dir}/${PROJ}.return_fixes && \
-cat ${bin_dir}/${PROJ}.return_fixes | \
-while read func old new ; do
-    echo "update return_states set return = '$new' where function = '$func' and return = '$old';" | sqlite3 $db_file
-done
+# caller_info is filled into its own file at the same time as the other
+# tables.  Copying it over afterwards is a plain bulk insert.
+merge_caller_info()
+{
+    cat << EOF | sqlite3 -bail $db_file
+PRAGMA synchronous = OFF;
+PRAGMA journal_mode = OFF;
+ATTACH '$caller_db' AS caller;
+BEGIN;
+INSERT INTO caller_info SELECT * FROM caller.caller_info;
+INSERT INTO common_caller_info SELECT * FROM caller.common_caller_info;
+COMMIT;
+DETACH caller;
+EOF
+}
+
+fill_type_ranges()
+{
+    if [ -x ${bin_dir}/../../smatch ] ; then
+        ${bin_dir}/../../smatch --db-file=$db_file --merge-type-ranges || return 1
+    else
+        ${bin_dir}/fill_db_type_value.pl "$PROJ" $info_file $db_file || return 1
+        ${bin_dir}/fill_db_type_size.pl "$PROJ" $info_file $db_file || return 1
+    fi
+    ${bin_dir}/copy_required_constraints.pl "$PROJ" $info_file $db_file || return 1
+}
+
+fixups()
+{
+    ${bin_dir}/fixup_all.sh $db_file || return 1
+    if [ -e ${bin_dir}/fixup_${PROJ}.sh ] ; then
+        ${bin_dir}/fixup_${PROJ}.sh $db_file || return 1
+    fi
+
+    ${bin_dir}/remove_mixed_up_pointer_params.pl $db_file || return 1
+    ${bin_dir}/mark_function_ptrs_searchable.pl $db_file || return 1
+}
+
+# functions with more than $fan_in callers get one merged call site in
+# common_caller_info so smatch doesn't load every caller
+summarize_callers()
+{
+    if [ -x ${bin_dir}/../../smatch ] ; then
+        ${bin_dir}/../../smatch --db-file=$db_file --summarize-caller-info=$fan_in || return 1
+    fi
+}
+
+# delete duplicate entrees and apply the return fixes in one transaction
+dedup()
+{
+    (
+        echo "BEGIN;"
+        echo "delete from function_ptr where rowid not in (select min(rowid) from function_ptr group by file, function, ptr, searchable);"
+        test -e ${bin_dir}/${PROJ}.return_fixes && \
+        awk -v q="'" '{ print "update return_states set return = " q $3 q " where function = " q $1 q " and return = " q $2 q ";" }' \
+            ${bin_dir}/${PROJ}.return_fixes
+        echo "COMMIT;"
+    ) | sqlite3 -bail $db_file
+}
+
+rm -f $db_file $caller_db
+
+must schema create_schema
+
+stage fill_caller_info fill_caller_info &
+caller_pid=$!
+stage fill_main fill_main
+main_ret=$?
+wait $caller_pid
+caller_ret=$?
+if [ $main_ret != 0 ] || [ $caller_ret != 0 ] ; then
+    echo "$0: filling the database failed" >&2
+    rm -f $db_file $caller_db
+    exit 1
+fi
+
+must merge_caller_info merge_caller_info
+rm -f $caller_db
+must early_index ${bin_dir}/build_early_index.sh $db_file $threads
+must type_ranges fill_type_ranges
+must late_index ${bin_dir}/build_late_index.sh $db_file $threads
+must fixups fixups
+must dedup dedup
+must summarize_callers summarize_callers
+must call_graph ${bin_dir}/build_call_graph.sh $db_file $threads
+if [ "$shared_returns" = "1" ] ; then
+    must shapes ${bin_dir}/build_return_shapes.sh $db_file $threads
+fi
+if [ "$clustered" = "1" ] ; then
+    must cluster ${bin_dir}/cluster_tables.sh $db_file $threads
+fi
 
 mv $db_file smatch_db.sqlite
@@ -15,6 +15,16 @@ fi
 bin_dir=$(dirname $0)
 db_file=smatch_db.sqlite
 
+if echo "select sql from sqlite_master where name = 'return_states';" | \
+        sqlite3 $db_file | grep -q "WITHOUT ROWID" ; then
+    echo "$0: $db_file was built with --clustered, rebuild it with create_db.sh"
+    exit 1
+fi
+if [ "$(echo "select type from sqlite_master where name = 'return_states';" | sqlite3 $db_file)" = "view" ] ; then
+    echo "$0: $db_file was built with --shared-returns, rebuild it with create_db.sh"
+    exit 1
+fi
+
 files=$(grep "insert into caller_info" $info_file | cut -d : -f 1 | sort -u)
 for c_file in $files; do
     echo "FILE $c_file"
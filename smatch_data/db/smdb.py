@@ -27,6 +27,14 @@ def usage():
     print "locals <file> - print the local values in a file."
     sys.exit(1)
 
+def has_table(name):
+    cur = con.cursor()
+    cur.execute("select count(*) from sqlite_master where type = 'table' and name = '%s';" %(name))
+    return cur.fetchone()[0] != 0
+
+# these are filled in by build_call_graph.sh
+have_call_graph = has_table("fn_ptr_closure") and has_table("call_edges") and has_table("param_trace")
+
 function_ptrs = []
 searched_ptrs = []
 def get_function_pointers_helper(func):
@@ -44,6 +52,14 @@ def get_function_pointers_helper(func):
 def get_function_pointers(func):
     global function_ptrs
     global searched_ptrs
+    if have_call_graph:
+        cur = con.cursor()
+        cur.execute("select ptr from fn_ptr_closure where function = '%s' order by depth;" %(func))
+        ptrs = [func]
+        for row in cur:
+            if row[0] not in ptrs:
+                ptrs.append(row[0])
+        return ptrs
     function_ptrs = [func]
     searched_ptrs = [func]
     get_function_pointers_helper(func)
@@ -491,7 +507,10 @@ def get_callers(func):
     cur = con.cursor()
     ptrs = get_function_pointers(func)
     for ptr in ptrs:
-        cur.execute("select distinct caller from caller_info where function = '%s';" %(ptr))
+        if have_call_graph:
+            cur.execute("select caller from call_edges where function = '%s';" %(ptr))
+        else:
+            cur.execute("select distinct caller from caller_info where function = '%s';" %(ptr))
         for row in cur:
             ret.append(row[0])
     return ret
@@ -531,8 +550,12 @@ def trace_callers(func, param):
 
     cur = con.cursor()
     ptrs = get_function_pointers(func)
+    if have_call_graph:
+        table = "param_trace"
+    else:
+        table = "caller_info"
     for ptr in ptrs:
-        cur.execute("select type, caller, value from caller_info where function = '%s' and (type = 0 or type = 1014 or type = 1028) and (parameter = -1 or parameter = %d);" %(ptr, param))
+        cur.execute("select type, caller, value from %s where function = '%s' and (type = 0 or type = 1014 or type = 1028) and (parameter = -1 or parameter = %d);" %(table, ptr, param))
         for row in cur:
             data_type = int(row[0])
             if data_type == 1014:
@@ -22,10 +22,9 @@
 #include "smatch.h"
 #include "smatch_slist.h"
 #include "smatch_extra.h"
+#include "smatch_function_hashtable.h"
 
 struct sqlite3 *smatch_db;
-struct sqlite3 *mem_db;
-struct sqlite3 *cache_db;
 
 static int return_id;
 
@@ -105,7 +104,10 @@ void sql_exec(struct sqlite3 *db, int (*callback)(void*, int, char**, char**), v
 	if (!db)
 		return;
 
-	rc = sqlite3_exec(db, sql, callback, data, &err);
+	if (option_db_profile)
+		rc = db_profile_exec(db, sql, callback, data, &err);
+	else
+		rc = sqlite3_exec(db, sql, callback, data, &err);
 	if (rc != SQLITE_OK && !parse_error) {
 		fprintf(stderr, "SQL error #2: %s\n", err);
 		fprintf(stderr, "SQL: '%s'\n", sql);
@@ -180,6 +182,10 @@ void sql_insert_return_states(int return_id, const char *return_ranges,
 	if (key && strlen(key) >= 80)
 		return;
 	return_ranges = replace_return_ranges(return_ranges);
+	if (__inline_fn)
+		mem_insert(mem_return_states, "%s %s %lu %d %s %d %d %d %s %s",
+			   get_base_file(), get_function(), (unsigned long)__inline_fn,
+			   return_id, return_ranges, fn_static(), type, param, key, value);
 	sql_insert(return_states, "'%s', '%s', %lu, %d, '%s', %d, %d, %d, '%s', '%s'",
 		   get_base_file(), get_function(), (unsigned long)__inline_fn,
 		   return_id, return_ranges, fn_static(), type, param, key, value);
@@ -226,10 +232,9 @@ void sql_insert_caller_info(struct expression *call, int type,
 		return;
 
 	if (__inline_call) {
-		mem_sql(NULL, NULL,
-			"insert into caller_info values ('%s', '%s', '%s', %lu, %d, %d, %d, '%s', '%s');",
-			get_base_file(), get_function(), fn, (unsigned long)call,
-			is_static(call->fn), type, param, key, value);
+		mem_insert(mem_caller_info, "%s %s %s %lu %d %d %d %s %s",
+			   get_base_file(), get_function(), fn, (unsigned long)call,
+			   is_static(call->fn), type, param, key, value);
 	}
 
 	if (!option_info)
@@ -258,6 +263,10 @@ void sql_insert_function_ptr(const char *fn, const char *struct_name)
 
 void sql_insert_return_implies(int type, int param, const char *key, const char *value)
 {
+	if (__inline_fn)
+		mem_insert(mem_return_implies, "%s %s %lu %d %d %d %s %s",
+			   get_base_file(), get_function(), (unsigned long)__inline_fn,
+			   fn_static(), type, param, key, value);
 	sql_insert_or_ignore(return_implies, "'%s', '%s', %lu, %d, %d, %d, '%s', '%s'",
 		get_base_file(), get_function(), (unsigned long)__inline_fn,
 		fn_static(), type, param, key, value);
@@ -265,6 +274,10 @@ void sql_insert_return_implies(int type, int param, const char *key, const char
 
 void sql_insert_call_implies(int type, int param, const char *key, const char *value)
 {
+	if (__inline_fn)
+		mem_insert(mem_call_implies, "%s %s %lu %d %d %d %s %s",
+			   get_base_file(), get_function(), (unsigned long)__inline_fn,
+			   fn_static(), type, param, key, value);
 	sql_insert_or_ignore(call_implies, "'%s', '%s', %lu, %d, %d, %d, '%s', '%s'",
 		get_base_file(), get_function(), (unsigned long)__inline_fn,
 		fn_static(), type, param, key, value);
@@ -282,7 +295,11 @@ void sql_insert_function_type_info(int type, const char *struct_type, const char
 
 void sql_insert_type_info(int type, const char *member, const char *value)
 {
-	sql_insert_cache(type_info, "'%s', %d, '%s', '%s'", get_base_file(), type, member, value);
+	if (cache_type_info) {
+		mem_insert(cache_type_info, "%s %d %s %s", get_base_file(), type, member, value);
+		return;
+	}
+	sql_insert_or_ignore(type_info, "'%s', %d, '%s', '%s'", get_base_file(), type, member, value);
 }
 
 void sql_insert_local_values(const char *name, const char *value)
@@ -510,6 +527,126 @@ static int is_local_symbol(struct expression *expr)
 	return 1;
 }
 
+/*
+ * A database built with create_db.sh --shared-returns keeps each distinct
+ * set of return_states rows once in return_shapes and return_states is a
+ * view.  The rows of a shape never change so they are loaded once and
+ * replayed for every later call to a function with the same shape.
+ */
+static int have_return_shapes;
+
+struct shape_rows {
+	int nr_rows;
+	int alloc;
+	int argc;
+	char **argv;
+	char **col_names;
+};
+static DEFINE_HASHTABLE_INSERT(insert_shape_rows, char, struct shape_rows);
+static DEFINE_HASHTABLE_SEARCH(search_shape_rows, char, struct shape_rows);
+static struct hashtable *shape_rows_hash;
+
+#define MAX_SHAPES 16
+
+struct shape_info {
+	int shapes[MAX_SHAPES];
+	int count;
+};
+
+static int get_shape(void *_info, int argc, char **argv, char **azColName)
+{
+	struct shape_info *info = _info;
+
+	if (argc != 1 || !argv[0])
+		return 0;
+	if (info->count < MAX_SHAPES)
+		info->shapes[info->count] = atoi(argv[0]);
+	info->count++;
+	return 0;
+}
+
+static char *copy_col(const char *str)
+{
+	return str ? alloc_string(str) : NULL;
+}
+
+static int save_shape_row(void *_rows, int argc, char **argv, char **azColName)
+{
+	struct shape_rows *rows = _rows;
+	int i;
+
+	if (!rows->col_names) {
+		rows->argc = argc;
+		rows->col_names = malloc(argc * sizeof(char *));
+		for (i = 0; i < argc; i++)
+			rows->col_names[i] = copy_col(azColName[i]);
+	}
+	if (rows->nr_rows == rows->alloc) {
+		rows->alloc = rows->alloc ? rows->alloc * 2 : 16;
+		rows->argv = realloc(rows->argv, rows->alloc * argc * sizeof(char *));
+	}
+	for (i = 0; i < argc; i++)
+		rows->argv[rows->nr_rows * argc + i] = copy_col(argv[i]);
+	rows->nr_rows++;
+	return 0;
+}
+
+static struct shape_rows *get_shape_rows(const char *cols, int shape)
+{
+	struct shape_rows *rows;
+	char key[256];
+
+	if (!shape_rows_hash)
+		shape_rows_hash = create_function_hashtable(1000);
+	snprintf(key, sizeof(key), "%d %s", shape, cols);
+	rows = search_shape_rows(shape_rows_hash, key);
+	if (rows)
+		return rows;
+
+	rows = calloc(1, sizeof(*rows));
+	run_sql(save_shape_row, rows,
+		"select %s from return_shapes where shape = %d order by return_id, type, rowid;",
+		cols, shape);
+	insert_shape_rows(shape_rows_hash, alloc_string(key), rows);
+	return rows;
+}
+
+static int select_shape_rows(const char *cols, struct expression *call,
+	int (*callback)(void*, int, char**, char**), void *info)
+{
+	struct shape_rows *rows[MAX_SHAPES];
+	struct shape_info shapes = {};
+	int row_count = 0;
+	int i, j;
+
+	/* return_shapes doesn't have these */
+	if (strstr(cols, "file") || strstr(cols, "function") || strstr(cols, "static"))
+		return 0;
+
+	/* one shape per file, in the "order by file" of sql_select_return_states() */
+	run_sql(get_shape, &shapes, "select shape from return_fns where %s order by file;",
+		get_static_filter(call->fn->symbol));
+	if (shapes.count > MAX_SHAPES)
+		return 0;
+
+	for (i = 0; i < shapes.count; i++) {
+		rows[i] = get_shape_rows(cols, shapes.shapes[i]);
+		row_count += rows[i]->nr_rows;
+	}
+	if (row_count > 3000)
+		return 1;
+
+	/* a non-zero return aborts the select, the same as with sqlite3_exec() */
+	for (i = 0; i < shapes.count; i++) {
+		for (j = 0; j < rows[i]->nr_rows; j++) {
+			if (callback(info, rows[i]->argc, &rows[i]->argv[j * rows[i]->argc],
+				     rows[i]->col_names))
+				return 1;
+		}
+	}
+	return 1;
+}
+
 void sql_select_return_states(const char *cols, struct expression *call,
 	int (*callback)(void*, int, char**, char**), void *info)
 {
@@ -524,12 +661,14 @@ void sql_select_return_states(const char *cols, struct expression *call,
 	}
 
 	if (inlinable(call->fn)) {
-		mem_sql(callback, info,
-			"select %s from return_states where call_id = '%lu' order by return_id, type;",
-			cols, (unsigned long)call);
+		mem_select(mem_return_states, cols, "return_id, type", callback, info,
+			   "call_id = %lu", (unsigned long)call);
 		return;
 	}
 
+	if (have_return_shapes && select_shape_rows(cols, call, callback, info))
+		return;
+
 	run_sql(get_row_count, &row_count, "select count(*) from return_states where %s;",
 		get_static_filter(call->fn->symbol));
 	if (row_count > 3000)
@@ -553,9 +692,8 @@ void sql_select_implies(const char *cols, struct implies_info *info,
 	int (*callback)(void*, int, char**, char**))
 {
 	if (info->type == RETURN_IMPLIES && inlinable(info->expr->fn)) {
-		mem_sql(callback, info,
-			"select %s from return_implies where call_id = '%lu';",
-			cols, (unsigned long)info->expr);
+		mem_select(mem_return_implies, cols, NULL, callback, info,
+			   "call_id = %lu", (unsigned long)info->expr);
 		return;
 	}
 
@@ -579,19 +717,23 @@ static void sql_select_caller_info(struct select_caller_info_data *data,
 	const char *cols, struct symbol *sym)
 {
 	if (__inline_fn) {
-		mem_sql(caller_info_callback, data,
-			"select %s from caller_info where call_id = %lu;",
-			cols, (unsigned long)__inline_fn);
+		mem_select(mem_caller_info, cols, NULL, caller_info_callback, data,
+			   "call_id = %lu", (unsigned long)__inline_fn);
 		return;
 	}
 
-	if (sym->ident->name && is_common_function(sym->ident->name))
-		return;
+	/*
+	 * common_caller_info holds either the summary of a function with a
+	 * lot of callers or a "too common" marker.  Either way we don't want
+	 * to load every caller.
+	 */
 	run_sql(caller_info_callback, data,
 		"select %s from common_caller_info where %s order by call_id;",
 		cols, get_static_filter(sym));
 	if (data->results)
 		return;
+	if (sym->ident->name && is_common_function(sym->ident->name))
+		return;
 
 	run_sql(caller_info_callback, data,
 		"select %s from caller_info where %s order by call_id;",
@@ -698,9 +840,9 @@ struct range_list *db_return_vals(struct expression *expr)
 
 	ret_info.return_range_list = NULL;
 	if (inlinable(expr->fn)) {
-		mem_sql(db_return_callback, &ret_info,
-			"select distinct return from return_states where call_id = '%lu';",
-			(unsigned long)expr);
+		mem_select(mem_return_states, "distinct return", NULL,
+			   db_return_callback, &ret_info,
+			   "call_id = %lu", (unsigned long)expr);
 	} else {
 		run_sql(db_return_callback, &ret_info,
 			"select distinct return from return_states where %s;",
@@ -2059,10 +2201,10 @@ static void print_returned_struct_members(int return_id, char *return_ranges, st
 
 static void reset_memdb(struct symbol *sym)
 {
-	mem_sql(NULL, NULL, "delete from caller_info;");
-	mem_sql(NULL, NULL, "delete from return_states;");
-	mem_sql(NULL, NULL, "delete from call_implies;");
-	mem_sql(NULL, NULL, "delete from return_implies;");
+	mem_delete(mem_caller_info, NULL);
+	mem_delete(mem_return_states, NULL);
+	mem_delete(mem_call_implies, NULL);
+	mem_delete(mem_return_implies, NULL);
 }
 
 static void match_end_func_info(struct symbol *sym)
@@ -2078,118 +2220,6 @@ static void match_after_func(struct symbol *sym)
 		reset_memdb(sym);
 }
 
-static void init_memdb(void)
-{
-	char *err = NULL;
-	int rc;
-	const char *schema_files[] = {
-		"db/db.schema",
-		"db/caller_info.schema",
-		"db/common_caller_info.schema",
-		"db/return_states.schema",
-		"db/function_type_size.schema",
-		"db/type_size.schema",
-		"db/function_type_info.schema",
-		"db/type_info.schema",
-		"db/call_implies.schema",
-		"db/return_implies.schema",
-		"db/function_ptr.schema",
-		"db/local_values.schema",
-		"db/function_type_value.schema",
-		"db/type_value.schema",
-		"db/function_type.schema",
-		"db/data_info.schema",
-		"db/parameter_name.schema",
-		"db/constraints.schema",
-		"db/constraints_required.schema",
-		"db/fn_ptr_data_link.schema",
-		"db/fn_data_link.schema",
-		"db/mtag_about.schema",
-		"db/mtag_map.schema",
-		"db/mtag_data.schema",
-		"db/mtag_alias.schema",
-	};
-	static char buf[4096];
-	int fd;
-	int ret;
-	int i;
-
-	rc = sqlite3_open(":memory:", &mem_db);
-	if (rc != SQLITE_OK) {
-		printf("Error starting In-Memory database.");
-		return;
-	}
-
-	for (i = 0; i < ARRAY_SIZE(schema_files); i++) {
-		fd = open_schema_file(schema_files[i]);
-		if (fd < 0)
-			continue;
-		ret = read(fd, buf, sizeof(buf));
-		if (ret < 0) {
-			printf("failed to read: %s\n", schema_files[i]);
-			continue;
-		}
-		close(fd);
-		if (ret == sizeof(buf)) {
-			printf("Schema file too large:  %s (limit %zd bytes)",
-			       schema_files[i], sizeof(buf));
-			continue;
-		}
-		buf[ret] = '\0';
-		rc = sqlite3_exec(mem_db, buf, NULL, NULL, &err);
-		if (rc != SQLITE_OK) {
-			fprintf(stderr, "SQL error #2: %s\n", err);
-			fprintf(stderr, "%s\n", buf);
-		}
-	}
-}
-
-static void init_cachedb(void)
-{
-	char *err = NULL;
-	int rc;
-	const char *schema_files[] = {
-		"db/call_implies.schema",
-		"db/return_implies.schema",
-		"db/type_info.schema",
-		"db/mtag_data.schema",
-		"db/sink_info.schema",
-	};
-	static char buf[4096];
-	int fd;
-	int ret;
-	int i;
-
-	rc = sqlite3_open(":memory:", &cache_db);
-	if (rc != SQLITE_OK) {
-		printf("Error starting In-Memory database.");
-		return;
-	}
-
-	for (i = 0; i < ARRAY_SIZE(schema_files); i++) {
-		fd = open_schema_file(schema_files[i]);
-		if (fd < 0)
-			continue;
-		ret = read(fd, buf, sizeof(buf));
-		if (ret < 0) {
-			printf("failed to read: %s\n", schema_files[i]);
-			continue;
-		}
-		close(fd);
-		if (ret == sizeof(buf)) {
-			printf("Schema file too large:  %s (limit %zd bytes)",
-			       schema_files[i], sizeof(buf));
-			continue;
-		}
-		buf[ret] = '\0';
-		rc = sqlite3_exec(cache_db, buf, NULL, NULL, &err);
-		if (rc != SQLITE_OK) {
-			fprintf(stderr, "SQL error #2: %s\n", err);
-			fprintf(stderr, "%s\n", buf);
-		}
-	}
-}
-
 static int save_cache_data(void *_table, int argc, char **argv, char **azColName)
 {
 	static char buf[4096];
@@ -2219,11 +2249,9 @@ static void dump_cache(struct symbol_list *sym_list)
 {
 	if (!option_info)
 		return;
-	cache_sql(&save_cache_data, (char *)"type_info", "select * from type_info;");
-	cache_sql(&save_cache_data, (char *)"return_implies", "select * from return_implies;");
-	cache_sql(&save_cache_data, (char *)"call_implies", "select * from call_implies;");
-	cache_sql(&save_cache_data, (char *)"mtag_data", "select * from mtag_data;");
-	cache_sql(&save_cache_data, (char *)"sink_info", "select * from sink_info;");
+	mem_select(cache_type_info, "*", NULL, &save_cache_data, (char *)"type_info", NULL);
+	mem_select(cache_mtag_data, "*", NULL, &save_cache_data, (char *)"mtag_data", NULL);
+	mem_select(cache_sink_info, "*", NULL, &save_cache_data, (char *)"sink_info", NULL);
 }
 
 void open_smatch_db(char *db_file)
@@ -2236,8 +2264,7 @@ void open_smatch_db(char *db_file)
 	use_states = malloc(num_checks + 1);
 	memset(use_states, 0xff, num_checks + 1);
 
-	init_memdb();
-	init_cachedb();
+	init_mem_db();
 
 	rc = sqlite3_open_v2(db_file, &smatch_db, SQLITE_OPEN_READONLY, NULL);
 	if (rc != SQLITE_OK) {
@@ -2246,6 +2273,8 @@ void open_smatch_db(char *db_file)
 	}
 	run_sql(NULL, NULL,
 		"PRAGMA cache_size = %d;", SQLITE_CACHE_PAGES);
+	run_sql(get_row_count, &have_return_shapes,
+		"select count(*) from sqlite_master where type = 'table' and name = 'return_fns';");
 	return;
 }
 
@@ -0,0 +1,670 @@
+/*
+ * Copyright (C) 2020 Dan Carpenter.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see http://www.gnu.org/copyleft/gpl.txt
+ */
+
+/*
+ * Steps of create_db.sh which are done by smatch itself instead of by the
+ * Perl scripts, so that they use the same range code as the rest of
+ * smatch.
+ *
+ * smatch --db-file=smatch_db.sqlite.new --merge-type-ranges
+ *
+ * fills type_value and type_size with the union of every range recorded
+ * for a struct member in function_type_value and function_type_size.
+ *
+ * smatch --db-file=smatch_db.sqlite.new --summarize-caller-info[=fan_in]
+ *
+ * adds one summary call site to common_caller_info for each function with
+ * more than fan_in call sites.  caller_info is left as it is.
+ */
+
+#include <string.h>
+#include <ctype.h>
+#include "smatch.h"
+#include "smatch_extra.h"
+
+#define MAX_TYPE_VALUE_RANGES 101
+
+static const char *range_names[] = {
+	"s64min", "s32min", "s16min", "s64max", "s32max", "s16max",
+	"u64max", "u32max", "u16max", "long_min", "long_max", "ulong_max",
+	"ptr_max",
+};
+
+/*
+ * Copy "value" to "out" leaving out the "ignore" entries if
+ * "skip_ignore" is set.  Returns 0 if the value contains something
+ * which isn't a plain range, such as a [==$0] comparison, and then the
+ * member is left out of the table like the Perl script did.
+ */
+static int clean_range_text(const char *value, int skip_ignore, char *out, int size)
+{
+	const char *p = value, *end;
+	int len = 0, i;
+
+	while (*p) {
+		end = strchr(p, ',');
+		if (!end)
+			end = p + strlen(p);
+
+		if (skip_ignore) {
+			const char *ignore = strstr(p, "ignore");
+
+			if (ignore && ignore < end)
+				goto next;
+		}
+
+		if (len + (end - p) + 2 > size)
+			return 0;
+		if (len)
+			out[len++] = ',';
+
+		while (p < end) {
+			if (isdigit(*p)) {
+				char *num_end;
+
+				strtoull(p, &num_end, 10);
+				memcpy(out + len, p, num_end - p);
+				len += num_end - p;
+				p = num_end;
+				continue;
+			}
+			if (*p == '(' || *p == ')' || *p == '-') {
+				out[len++] = *p++;
+				continue;
+			}
+			for (i = 0; i < ARRAY_SIZE(range_names); i++) {
+				if (strncmp(p, range_names[i], strlen(range_names[i])) == 0)
+					break;
+			}
+			if (i == ARRAY_SIZE(range_names))
+				return 0;
+			memcpy(out + len, p, strlen(range_names[i]));
+			len += strlen(range_names[i]);
+			p += strlen(range_names[i]);
+		}
+next:
+		p = *end ? end + 1 : end;
+	}
+	out[len] = '\0';
+	return 1;
+}
+
+/* Does this single range go past s64max? */
+static int range_is_unsigned(const char *range)
+{
+	const char *p;
+	char *end;
+
+	if (strstr(range, "u64max") || strstr(range, "ulong_max") ||
+	    strstr(range, "ptr_max"))
+		return 1;
+	for (p = range; *p; p++) {
+		if (!isdigit(*p))
+			continue;
+		if (strtoull(p, &end, 10) > LLONG_MAX)
+			return 1;
+		p = end - 1;
+	}
+	return 0;
+}
+
+static void append_rl(char **buf, int *len, int *size, struct range_list *rl)
+{
+	struct data_range *tmp;
+	char range[128];
+	int n;
+
+	FOR_EACH_PTR(rl, tmp) {
+		if (sval_cmp(tmp->min, tmp->max) == 0)
+			n = snprintf(range, sizeof(range), "%s", sval_to_str(tmp->min));
+		else
+			n = snprintf(range, sizeof(range), "%s-%s",
+				     sval_to_str(tmp->min), sval_to_str(tmp->max));
+		if (*len + n + 2 > *size) {
+			*size = (*size + n) * 2;
+			*buf = realloc(*buf, *size);
+		}
+		if (*len)
+			(*buf)[(*len)++] = ',';
+		memcpy(*buf + *len, range, n + 1);
+		*len += n;
+	} END_FOR_EACH_PTR(tmp);
+}
+
+/*
+ * Union the cleaned range lists in "values" the way the Perl scripts did
+ * with bigint: as ranges of plain integers from s64min to u64max.  Neither
+ * long long nor unsigned long long holds both (-1) and u64max, so the
+ * negative part is kept as long long and the rest as unsigned long long
+ * and they are printed one after the other.  Returns a malloc()ed string
+ * or NULL if there is nothing.
+ */
+static char *union_range_text(struct string_list *values, int *nr_ranges)
+{
+	struct range_list *neg = NULL, *pos = NULL, *rl;
+	sval_t min, max;
+	char *value, *range, *next;
+	char buf[1024];
+	char *ret = NULL;
+	int len = 0, size = 0;
+
+	min = sval_type_min(&llong_ctype);
+	max = sval_type_val(&llong_ctype, -1);
+	FOR_EACH_PTR(values, value) {
+		snprintf(buf, sizeof(buf), "%s", value);
+		for (range = buf; range; range = next) {
+			next = strchr(range, ',');
+			if (next)
+				*next++ = '\0';
+			if (range_is_unsigned(range)) {
+				str_to_rl(&ullong_ctype, range, &rl);
+				pos = rl_union(pos, rl);
+				continue;
+			}
+			str_to_rl(&llong_ctype, range, &rl);
+			neg = rl_union(neg, rl_intersection(rl, alloc_rl(min, max)));
+			rl = remove_range(rl, min, max);
+			pos = rl_union(pos, cast_rl(&ullong_ctype, rl));
+		}
+	} END_FOR_EACH_PTR(value);
+
+	/* everything fits in a long long so print it the normal way */
+	if (!pos || sval_cmp(rl_max(pos), sval_type_max(&llong_ctype)) <= 0) {
+		neg = rl_union(neg, cast_rl(&llong_ctype, pos));
+		pos = NULL;
+	}
+
+	*nr_ranges = ptr_list_size((struct ptr_list *)neg) +
+		     ptr_list_size((struct ptr_list *)pos);
+	append_rl(&ret, &len, &size, neg);
+	append_rl(&ret, &len, &size, pos);
+	return ret;
+}
+
+struct type_ranges {
+	const char *select;
+	const char *insert;
+	int skip_ignore;
+	int max_ranges;
+};
+
+static struct type_ranges type_value = {
+	"select type, value from function_type_value order by type;",
+	"insert into type_value values (?, ?);",
+	1, MAX_TYPE_VALUE_RANGES,
+};
+
+static struct type_ranges type_size = {
+	"select type, size from function_type_size order by type;",
+	"insert into type_size values (?, ?);",
+	0, 0,
+};
+
+struct range_group {
+	char *type;
+	struct string_list *values;
+	int skip;
+	int nr_types;
+	int nr_skipped;
+};
+
+static int flush_group(struct type_ranges *t, struct range_group *g, sqlite3_stmt *insert)
+{
+	char *text = NULL, *value;
+	int nr_ranges = 0;
+	int ret = 0;
+
+	if (!g->type)
+		return 0;
+	g->nr_types++;
+
+	if (!g->skip)
+		text = union_range_text(g->values, &nr_ranges);
+
+	if (g->skip || !text) {
+		g->nr_skipped++;
+	} else if (t->max_ranges && nr_ranges > t->max_ranges) {
+		printf("%s %d\n", g->type, nr_ranges);
+		g->nr_skipped++;
+	} else {
+		sqlite3_bind_text(insert, 1, g->type, -1, SQLITE_STATIC);
+		sqlite3_bind_text(insert, 2, text, -1, SQLITE_STATIC);
+		if (sqlite3_step(insert) != SQLITE_DONE) {
+			fprintf(stderr, "merge_type_ranges: %s: %s\n", g->type,
+				sqlite3_errmsg(sqlite3_db_handle(insert)));
+			ret = 1;
+		}
+		sqlite3_reset(insert);
+	}
+	free(text);
+
+	FOR_EACH_PTR(g->values, value) {
+		free(value);
+	} END_FOR_EACH_PTR(value);
+	free_ptr_list(&g->values);
+	free(g->type);
+	g->type = NULL;
+	g->skip = 0;
+
+	/* the range lists are only needed until the group is written */
+	if (g->nr_types % 4096 == 0)
+		free_data_info_allocs();
+	return ret;
+}
+
+static int merge_one_table(sqlite3 *db, struct type_ranges *t)
+{
+	struct range_group g = {};
+	sqlite3_stmt *select, *insert;
+	char buf[1024];
+	int ret = 0;
+	int rc;
+
+	if (sqlite3_prepare_v2(db, t->select, -1, &select, NULL) != SQLITE_OK ||
+	    sqlite3_prepare_v2(db, t->insert, -1, &insert, NULL) != SQLITE_OK) {
+		fprintf(stderr, "merge_type_ranges: %s\n", sqlite3_errmsg(db));
+		return 1;
+	}
+
+	while ((rc = sqlite3_step(select)) == SQLITE_ROW) {
+		const char *type = (const char *)sqlite3_column_text(select, 0);
+		const char *value = (const char *)sqlite3_column_text(select, 1);
+
+		if (!type || !value)
+			continue;
+		if (!g.type || strcmp(g.type, type) != 0) {
+			ret = flush_group(t, &g, insert);
+			if (ret)
+				break;
+			g.type = strdup(type);
+		}
+		if (g.skip)
+			continue;
+		if (!clean_range_text(value, t->skip_ignore, buf, sizeof(buf))) {
+			g.skip = 1;
+			continue;
+		}
+		if (buf[0]) {
+			char *copy = strdup(buf);
+
+			add_ptr_list(&g.values, copy);
+		}
+	}
+	if (!ret)
+		ret = flush_group(t, &g, insert);
+
+	sqlite3_finalize(select);
+	sqlite3_finalize(insert);
+	free_data_info_allocs();
+
+	if (ret)
+		return ret;
+	if (rc != SQLITE_DONE) {
+		fprintf(stderr, "merge_type_ranges: %s\n", sqlite3_errmsg(db));
+		return 1;
+	}
+	return 0;
+}
+
+int merge_type_ranges(const char *db_file)
+{
+	sqlite3 *db;
+	int ret;
+
+	if (sqlite3_open(db_file, &db) != SQLITE_OK) {
+		fprintf(stderr, "merge_type_ranges: cannot open %s\n", db_file);
+		return 1;
+	}
+	init_symbols();
+	init_ctype();
+
+	if (sqlite3_exec(db, "PRAGMA journal_mode = OFF; PRAGMA synchronous = OFF;"
+			 "PRAGMA temp_store = MEMORY; BEGIN;", NULL, NULL, NULL) != SQLITE_OK) {
+		fprintf(stderr, "merge_type_ranges: %s\n", sqlite3_errmsg(db));
+		sqlite3_close(db);
+		return 1;
+	}
+	ret = merge_one_table(db, &type_value);
+	if (!ret)
+		ret = merge_one_table(db, &type_size);
+	if (sqlite3_exec(db, "COMMIT;", NULL, NULL, NULL) != SQLITE_OK) {
+		fprintf(stderr, "merge_type_ranges: %s\n", sqlite3_errmsg(db));
+		ret = 1;
+	}
+	sqlite3_close(db);
+	return ret;
+}
+
+/*
+ * A function like mutex_lock() or copy_from_user() has so many callers that loading
+ * its caller_info takes longer than the rest of the function.  The callee
+ * merges the states from every call site anyway, so we can do the merge
+ * here once and store the result as a single call site with call_id 0 in
+ * common_caller_info.  sql_select_caller_info() looks there first and
+ * doesn't read caller_info if it finds anything.
+ *
+ * Only PARAM_VALUE is merged.  A call site which doesn't have a
+ * PARAM_VALUE means the whole range, so if some call sites don't have it
+ * or the ranges get too complicated it is just left out.  Other types,
+ * such as USER_DATA, have no such meaning.  Leaving them out would lose
+ * the ones which only some callers pass, so if any of them is missing or
+ * different at a call site then the function is left alone and keeps its
+ * "too common" marker.  The same goes for functions whose signatures
+ * (INTERNAL rows) don't all match.  caller_info itself is not changed so
+ * smdb.py still sees every caller.
+ *
+ * Functions in <project>.common_functions only have their INTERNAL rows in
+ * caller_info, so there is nothing to summarize for them and they keep
+ * their marker as well.
+ */
+
+#define MAX_SUMMARY_VALUES 256
+
+struct caller_key {
+	int type;
+	int param;
+	char *key;
+	struct string_list *values;
+	int bad;
+	int nr_calls;
+	long long last_call;
+};
+DECLARE_PTR_LIST(caller_key_list, struct caller_key);
+
+struct caller_fn {
+	char *file;
+	char *function;
+	int is_static;
+};
+DECLARE_PTR_LIST(caller_fn_list, struct caller_fn);
+
+static struct caller_key *get_caller_key(struct caller_key_list **keys, int type, int param, const char *key)
+{
+	struct caller_key *ck;
+
+	FOR_EACH_PTR(*keys, ck) {
+		if (ck->type == type && ck->param == param && strcmp(ck->key, key) == 0)
+			return ck;
+	} END_FOR_EACH_PTR(ck);
+
+	ck = calloc(1, sizeof(*ck));
+	ck->type = type;
+	ck->param = param;
+	ck->key = strdup(key);
+	ck->last_call = -1;
+	add_ptr_list(keys, ck);
+	return ck;
+}
+
+static void add_caller_value(struct caller_key *ck, long long call_id, const char *value)
+{
+	char buf[1024];
+	char *tmp, *copy;
+
+	if (ck->last_call == call_id) {
+		/* set twice in one call, just give up */
+		ck->bad = 1;
+		return;
+	}
+	ck->last_call = call_id;
+	ck->nr_calls++;
+	if (ck->bad)
+		return;
+
+	if (ck->type == PARAM_VALUE) {
+		if (!clean_range_text(value, 0, buf, sizeof(buf))) {
+			ck->bad = 1;
+			return;
+		}
+		value = buf;
+	} else if (ck->values && strcmp(first_ptr_list((struct ptr_list *)ck->values), value) != 0) {
+		ck->bad = 1;
+		return;
+	}
+
+	FOR_EACH_PTR(ck->values, tmp) {
+		if (strcmp(tmp, value) == 0)
+			return;
+	} END_FOR_EACH_PTR(tmp);
+
+	if (ptr_list_size((struct ptr_list *)ck->values) >= MAX_SUMMARY_VALUES) {
+		ck->bad = 1;
+		return;
+	}
+	copy = strdup(value);
+	add_ptr_list(&ck->values, copy);
+}
+
+/* returns a malloc()ed string */
+static char *summary_value(struct caller_key *ck)
+{
+	int nr_ranges;
+
+	if (ck->type != PARAM_VALUE || ptr_list_size((struct ptr_list *)ck->values) == 1)
+		return strdup(first_ptr_list((struct ptr_list *)ck->values));
+
+	return union_range_text(ck->values, &nr_ranges);
+}
+
+static void free_caller_keys(struct caller_key_list **keys)
+{
+	struct caller_key *ck;
+	char *value;
+
+	FOR_EACH_PTR(*keys, ck) {
+		FOR_EACH_PTR(ck->values, value) {
+			free(value);
+		} END_FOR_EACH_PTR(value);
+		free_ptr_list(&ck->values);
+		free(ck->key);
+		free(ck);
+	} END_FOR_EACH_PTR(ck);
+	free_ptr_list(keys);
+}
+
+/* a summary with only the INTERNAL rows says nothing about the callers */
+static int has_param_facts(struct caller_key_list *keys, int nr_calls)
+{
+	struct caller_key *ck;
+
+	FOR_EACH_PTR(keys, ck) {
+		if (ck->type != INTERNAL && !ck->bad && ck->nr_calls == nr_calls)
+			return 1;
+	} END_FOR_EACH_PTR(ck);
+	return 0;
+}
+
+struct summary_stmts {
+	sqlite3_stmt *select;
+	sqlite3_stmt *insert;
+	sqlite3_stmt *delete;
+};
+
+/*
+ * Returns the number of summary rows written, 0 if the function was left
+ * alone and -1 on a database error.
+ */
+static int summarize_one_function(struct caller_fn *fn, struct summary_stmts *s)
+{
+	sqlite3_stmt *select = s->select, *insert = s->insert;
+	struct caller_key_list *keys = NULL;
+	struct caller_key *ck;
+	char *value;
+	long long call_id, prev_call = -1;
+	int nr_calls = 0;
+	int rows = 0;
+
+	sqlite3_bind_text(select, 1, fn->function, -1, SQLITE_STATIC);
+	sqlite3_bind_int(select, 2, fn->is_static);
+	sqlite3_bind_text(select, 3, fn->file, -1, SQLITE_STATIC);
+	while (sqlite3_step(select) == SQLITE_ROW) {
+		const char *key = (const char *)sqlite3_column_text(select, 3);
+		const char *value = (const char *)sqlite3_column_text(select, 4);
+
+		call_id = sqlite3_column_int64(select, 0);
+		if (call_id != prev_call) {
+			nr_calls++;
+			prev_call = call_id;
+		}
+		ck = get_caller_key(&keys, sqlite3_column_int(select, 1),
+				    sqlite3_column_int(select, 2), key ? key : "");
+		add_caller_value(ck, call_id, value ? value : "");
+	}
+	sqlite3_reset(select);
+
+	FOR_EACH_PTR(keys, ck) {
+		if (ck->type == PARAM_VALUE)
+			continue;
+		if (ck->bad || ck->nr_calls != nr_calls)
+			goto free;
+	} END_FOR_EACH_PTR(ck);
+	if (!has_param_facts(keys, nr_calls))
+		goto free;
+
+	FOR_EACH_PTR(keys, ck) {
+		if (ck->bad || ck->nr_calls != nr_calls)
+			continue;
+		sqlite3_bind_text(insert, 1, fn->is_static ? fn->file : "unknown", -1, SQLITE_STATIC);
+		sqlite3_bind_text(insert, 2, fn->function, -1, SQLITE_STATIC);
+		sqlite3_bind_int(insert, 3, fn->is_static);
+		sqlite3_bind_int(insert, 4, ck->type);
+		sqlite3_bind_int(insert, 5, ck->param);
+		sqlite3_bind_text(insert, 6, ck->key, -1, SQLITE_STATIC);
+		value = summary_value(ck);
+		sqlite3_bind_text(insert, 7, value ? value : "", -1, SQLITE_TRANSIENT);
+		free(value);
+		if (sqlite3_step(insert) != SQLITE_DONE) {
+			fprintf(stderr, "summarize_caller_info: %s: %s\n", fn->function,
+				sqlite3_errmsg(sqlite3_db_handle(insert)));
+			sqlite3_reset(insert);
+			rows = -1;
+			goto free;
+		}
+		sqlite3_reset(insert);
+		rows++;
+	} END_FOR_EACH_PTR(ck);
+
+	/* the "too common" marker from fill_db_caller_info.pl isn't needed now */
+	if (!fn->is_static) {
+		sqlite3_bind_text(s->delete, 1, fn->function, -1, SQLITE_STATIC);
+		if (sqlite3_step(s->delete) != SQLITE_DONE) {
+			fprintf(stderr, "summarize_caller_info: %s: %s\n", fn->function,
+				sqlite3_errmsg(sqlite3_db_handle(s->delete)));
+			rows = -1;
+		}
+		sqlite3_reset(s->delete);
+	}
+free:
+	free_caller_keys(&keys);
+	free_data_info_allocs();
+	return rows;
+}
+
+static int get_caller_fn(void *_list, int argc, char **argv, char **azColName)
+{
+	struct caller_fn_list **list = _list;
+	struct caller_fn *fn;
+
+	if (argc != 3 || !argv[0] || !argv[1] || !argv[2])
+		return 0;
+	fn = calloc(1, sizeof(*fn));
+	fn->file = strdup(argv[0]);
+	fn->function = strdup(argv[1]);
+	fn->is_static = atoi(argv[2]);
+	add_ptr_list(list, fn);
+	return 0;
+}
+
+int summarize_caller_info(const char *db_file, int fan_in)
+{
+	struct caller_fn_list *fns = NULL;
+	struct summary_stmts s;
+	struct caller_fn *fn;
+	char sql[512];
+	sqlite3 *db;
+	int nr_fns = 0, nr_skipped = 0, rows = 0;
+	int ret = 0;
+	int tmp;
+
+	if (sqlite3_open(db_file, &db) != SQLITE_OK) {
+		fprintf(stderr, "summarize_caller_info: cannot open %s\n", db_file);
+		return 1;
+	}
+	init_symbols();
+	init_ctype();
+
+	snprintf(sql, sizeof(sql),
+		 "select file, function, 1 from caller_info where static = 1 group by file, function having count(distinct call_id) > %d "
+		 "union all "
+		 "select '', function, 0 from caller_info where static = 0 group by function having count(distinct call_id) > %d;",
+		 fan_in, fan_in);
+	if (sqlite3_exec(db, sql, get_caller_fn, &fns, NULL) != SQLITE_OK) {
+		fprintf(stderr, "summarize_caller_info: %s\n", sqlite3_errmsg(db));
+		sqlite3_close(db);
+		return 1;
+	}
+
+	if (sqlite3_prepare_v2(db,
+			"select call_id, type, parameter, key, value from caller_info "
+			"where function = ?1 and static = ?2 and (?2 = 0 or file = ?3) order by call_id;",
+			-1, &s.select, NULL) != SQLITE_OK ||
+	    sqlite3_prepare_v2(db,
+			"insert into common_caller_info values (?1, 'summary', ?2, 0, ?3, ?4, ?5, ?6, ?7);",
+			-1, &s.insert, NULL) != SQLITE_OK ||
+	    sqlite3_prepare_v2(db,
+			"delete from common_caller_info where function = ?1 and caller = 'too common';",
+			-1, &s.delete, NULL) != SQLITE_OK) {
+		fprintf(stderr, "summarize_caller_info: %s\n", sqlite3_errmsg(db));
+		sqlite3_close(db);
+		return 1;
+	}
+
+	if (sqlite3_exec(db, "PRAGMA journal_mode = OFF; PRAGMA synchronous = OFF;"
+			 "PRAGMA temp_store = MEMORY; BEGIN;", NULL, NULL, NULL) != SQLITE_OK) {
+		fprintf(stderr, "summarize_caller_info: %s\n", sqlite3_errmsg(db));
+		ret = 1;
+		goto finalize;
+	}
+	FOR_EACH_PTR(fns, fn) {
+		tmp = summarize_one_function(fn, &s);
+		if (tmp < 0) {
+			ret = 1;
+			goto commit;
+		}
+		if (tmp == 0)
+			nr_skipped++;
+		rows += tmp;
+		nr_fns++;
+	} END_FOR_EACH_PTR(fn);
+commit:
+	if (sqlite3_exec(db, "COMMIT;", NULL, NULL, NULL) != SQLITE_OK) {
+		fprintf(stderr, "summarize_caller_info: %s\n", sqlite3_errmsg(db));
+		ret = 1;
+	}
+
+finalize:
+	sqlite3_finalize(s.select);
+	sqlite3_finalize(s.insert);
+	sqlite3_finalize(s.delete);
+	sqlite3_close(db);
+
+	if (ret)
+		return ret;
+	printf("summarized %d functions into %d rows, left %d alone\n",
+	       nr_fns - nr_skipped, rows, nr_skipped);
+	return 0;
+}
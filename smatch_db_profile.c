@@ -0,0 +1,212 @@
+/*
+ * Copyright (C) 2020 Dan Carpenter.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see http://www.gnu.org/copyleft/gpl.txt
+ */
+
+/*
+ * --db-profile[=file] records every query sent to smatch_db.sqlite.  The
+ * queries are grouped by shape, which is the SQL with the string and
+ * number literals replaced by '?'.  For each shape we keep the count,
+ * the time spent and the number of rows returned, and the first time a
+ * shape is seen we ask sqlite for its query plan.  Plans which scan a
+ * whole table or build a temp b-tree to sort are flagged.
+ *
+ * The report is one tab separated line per shape, slowest first:
+ *
+ * <total usec> <count> <rows> <flags> <shape> <plan>
+ *
+ * It is appended to the file, or printed to stderr when no file is
+ * given, so the reports from a whole kernel build can be combined with
+ * sort and awk.
+ */
+
+#include <ctype.h>
+#include <time.h>
+#include "smatch.h"
+#include "smatch_function_hashtable.h"
+
+struct query_shape {
+	char *shape;
+	char *plan;
+	int flags;
+	unsigned long count;
+	unsigned long rows;
+	unsigned long long usec;
+};
+DECLARE_PTR_LIST(query_shape_list, struct query_shape);
+
+#define SHAPE_SCAN	1
+#define SHAPE_SORT	2
+
+static DEFINE_HASHTABLE_INSERT(insert_shape, char, struct query_shape);
+static DEFINE_HASHTABLE_SEARCH(search_shape, char, struct query_shape);
+static struct hashtable *shape_hash;
+static struct query_shape_list *shapes;
+
+struct profile_data {
+	int (*callback)(void*, int, char**, char**);
+	void *data;
+	unsigned long rows;
+};
+
+static int count_rows(void *_info, int argc, char **argv, char **azColName)
+{
+	struct profile_data *info = _info;
+
+	info->rows++;
+	if (!info->callback)
+		return 0;
+	return info->callback(info->data, argc, argv, azColName);
+}
+
+static void get_shape(const char *sql, char *buf, int size)
+{
+	const char *p = sql;
+	int len = 0;
+
+	while (*p && len < size - 2) {
+		if (*p == '\'') {
+			p++;
+			while (*p) {
+				if (p[0] == '\'' && p[1] == '\'')
+					p++;
+				else if (p[0] == '\'')
+					break;
+				p++;
+			}
+			if (*p)
+				p++;
+			buf[len++] = '?';
+			continue;
+		}
+		if ((isdigit(*p) || (*p == '-' && isdigit(p[1]))) &&
+		    (p == sql || !(isalnum(p[-1]) || p[-1] == '_'))) {
+			p++;
+			while (isdigit(*p))
+				p++;
+			buf[len++] = '?';
+			continue;
+		}
+		buf[len++] = *p++;
+	}
+	buf[len] = '\0';
+}
+
+static int add_plan_line(void *_plan, int argc, char **argv, char **azColName)
+{
+	char *plan = _plan;
+	int len = strlen(plan);
+
+	/* id, parent, notused, detail */
+	if (argc < 4 || !argv[3])
+		return 0;
+	snprintf(plan + len, 1024 - len, "%s%s", len ? "; " : "", argv[3]);
+	return 0;
+}
+
+static void explain(struct sqlite3 *db, const char *sql, struct query_shape *shape)
+{
+	char query[1024 + 32];
+	char plan[1024] = "";
+
+	snprintf(query, sizeof(query), "EXPLAIN QUERY PLAN %s", sql);
+	sqlite3_exec(db, query, add_plan_line, plan, NULL);
+	shape->plan = alloc_string(plan);
+
+	/* "SCAN t USING INDEX" still reads every row of the index */
+	if (strstr(plan, "SCAN "))
+		shape->flags |= SHAPE_SCAN;
+	if (strstr(plan, "TEMP B-TREE"))
+		shape->flags |= SHAPE_SORT;
+}
+
+static unsigned long long now_usec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+int db_profile_exec(struct sqlite3 *db, const char *sql,
+		    int (*callback)(void*, int, char**, char**), void *data,
+		    char **err)
+{
+	struct profile_data info = { callback, data, 0 };
+	struct query_shape *shape;
+	unsigned long long start, usec;
+	char buf[1024];
+	int rc;
+
+	start = now_usec();
+	rc = sqlite3_exec(db, sql, count_rows, &info, err);
+	usec = now_usec() - start;
+
+	if (!shape_hash)
+		shape_hash = create_function_hashtable(1000);
+	get_shape(sql, buf, sizeof(buf));
+	shape = search_shape(shape_hash, buf);
+	if (!shape) {
+		shape = calloc(1, sizeof(*shape));
+		shape->shape = alloc_string(buf);
+		explain(db, sql, shape);
+		insert_shape(shape_hash, shape->shape, shape);
+		add_ptr_list(&shapes, shape);
+	}
+	shape->count++;
+	shape->rows += info.rows;
+	shape->usec += usec;
+
+	return rc;
+}
+
+static int cmp_usec(const void *_a, const void *_b)
+{
+	const struct query_shape *a = _a;
+	const struct query_shape *b = _b;
+
+	if (a->usec != b->usec)
+		return a->usec > b->usec ? -1 : 1;
+	return strcmp(a->shape, b->shape);
+}
+
+void db_profile_report(void)
+{
+	struct query_shape *shape;
+	FILE *out = stderr;
+
+	if (!option_db_profile || !shapes)
+		return;
+	if (option_db_profile[0]) {
+		out = fopen(option_db_profile, "a");
+		if (!out) {
+			fprintf(stderr, "cannot open %s\n", option_db_profile);
+			return;
+		}
+	}
+
+	sort_list((struct ptr_list **)&shapes, cmp_usec);
+	FOR_EACH_PTR(shapes, shape) {
+		fprintf(out, "%llu\t%lu\t%lu\t%s%s%s\t%s\t%s\n",
+			shape->usec, shape->count, shape->rows,
+			shape->flags ? "" : "-",
+			(shape->flags & SHAPE_SCAN) ? "S" : "",
+			(shape->flags & SHAPE_SORT) ? "T" : "",
+			shape->shape, shape->plan);
+	} END_FOR_EACH_PTR(shape);
+
+	if (out != stderr)
+		fclose(out);
+}
@@ -21,6 +21,7 @@
  */
 
 #include <stdlib.h>
+#include <string.h>
 #ifndef __USE_ISOC99
 #define __USE_ISOC99
 #endif
@@ -30,6 +31,155 @@
 #include "smatch_slist.h"
 #include "smatch_extra.h"
 
+/*
+ * Most merges are variables which only hold a few small constants: flags,
+ * loop counters and error codes.  Those are represented as a bitmask so the
+ * union is just an OR and the merged range list is cached per function so
+ * we don't rebuild it every time the same values get merged.  The estate
+ * itself is always freshly allocated because callers modify estates in
+ * place (hard_max, fuzzy_max, related).
+ */
+#define CONST_BITS 128
+#define CONST_HASH_SIZE 256
+
+struct const_set {
+	unsigned long long bits[CONST_BITS / 64];
+};
+
+struct const_estate {
+	struct symbol *type;
+	struct const_set set;
+	struct range_list *rl;
+	struct const_estate *next;
+};
+
+static struct const_estate *const_estates[CONST_HASH_SIZE];
+
+static long long const_base(struct symbol *type)
+{
+	if (type_unsigned(type))
+		return 0;
+	return -(CONST_BITS / 2);
+}
+
+static int get_const_set(struct smatch_state *state, struct symbol *type,
+			 struct const_set *set)
+{
+	struct data_range *tmp;
+	long long base = const_base(type);
+	long long val;
+
+	if (estate_related(state))
+		return 0;
+
+	memset(set, 0, sizeof(*set));
+	FOR_EACH_PTR(estate_rl(state), tmp) {
+		if (tmp->min.type != type || tmp->max.type != type)
+			return 0;
+		if (tmp->min.value < base || tmp->max.value >= base + CONST_BITS ||
+		    tmp->max.value < tmp->min.value)
+			return 0;
+		for (val = tmp->min.value - base; val <= tmp->max.value - base; val++)
+			set->bits[val / 64] |= 1ULL << (val % 64);
+	} END_FOR_EACH_PTR(tmp);
+
+	return 1;
+}
+
+static struct range_list *const_set_to_rl(struct symbol *type, struct const_set *set)
+{
+	struct range_list *rl = NULL;
+	long long base = const_base(type);
+	int start = -1;
+	int i;
+
+	for (i = 0; i <= CONST_BITS; i++) {
+		if (i < CONST_BITS && (set->bits[i / 64] & (1ULL << (i % 64)))) {
+			if (start < 0)
+				start = i;
+			continue;
+		}
+		if (start < 0)
+			continue;
+		add_range(&rl, sval_type_val(type, base + start),
+			  sval_type_val(type, base + i - 1));
+		start = -1;
+	}
+	return rl;
+}
+
+static unsigned int const_hash(struct symbol *type, struct const_set *set)
+{
+	unsigned long long hash;
+	int i;
+
+	hash = (unsigned long)type;
+	for (i = 0; i < CONST_BITS / 64; i++)
+		hash = hash * 1000003 ^ set->bits[i];
+	hash ^= hash >> 32;
+	hash ^= hash >> 16;
+	return hash % CONST_HASH_SIZE;
+}
+
+static struct smatch_state *merge_const_estates(struct smatch_state *s1, struct smatch_state *s2)
+{
+	struct smatch_state *ret;
+	struct const_estate *ce;
+	struct const_set one, two;
+	struct symbol *type;
+	sval_t fuzzy_max;
+	unsigned int hash;
+	int hard_max;
+	int i;
+
+	type = rl_type(estate_rl(s1));
+	if (!type || type != rl_type(estate_rl(s2)))
+		return NULL;
+	if (!get_const_set(s1, type, &one) || !get_const_set(s2, type, &two))
+		return NULL;
+
+	for (i = 0; i < CONST_BITS / 64; i++)
+		one.bits[i] |= two.bits[i];
+	hard_max = estate_has_hard_max(s1) && estate_has_hard_max(s2);
+	fuzzy_max = sval_max(estate_get_fuzzy_max(s1), estate_get_fuzzy_max(s2));
+
+	hash = const_hash(type, &one);
+	for (ce = const_estates[hash]; ce; ce = ce->next) {
+		if (ce->type == type &&
+		    memcmp(&ce->set, &one, sizeof(one)) == 0)
+			break;
+	}
+	if (!ce) {
+		ce = malloc(sizeof(*ce));
+		ce->type = type;
+		ce->set = one;
+		ce->rl = const_set_to_rl(type, &one);
+		ce->next = const_estates[hash];
+		const_estates[hash] = ce;
+	}
+
+	ret = alloc_estate_rl(ce->rl);
+	if (hard_max)
+		estate_set_hard_max(ret);
+	estate_set_fuzzy_max(ret, fuzzy_max);
+
+	return ret;
+}
+
+void clear_const_estate_cache(void)
+{
+	struct const_estate *ce, *next;
+	int i;
+
+	for (i = 0; i < CONST_HASH_SIZE; i++) {
+		for (ce = const_estates[i]; ce; ce = next) {
+			next = ce->next;
+			free(ce);
+		}
+		const_estates[i] = NULL;
+	}
+}
+
 struct smatch_state *merge_estates(struct smatch_state *s1, struct smatch_state *s2)
 {
 	struct smatch_state *tmp;
@@ -39,6 +189,10 @@ struct smatch_state *merge_estates(struct smatch_state *s1, struct smatch_state
 	if (estates_equiv(s1, s2))
 		return s1;
 
+	tmp = merge_const_estates(s1, s2);
+	if (tmp)
+		return tmp;
+
 	value_ranges = rl_union(estate_rl(s1), estate_rl(s2));
 	tmp = alloc_estate_rl(value_ranges);
 	rlist = get_shared_relations(estate_related(s1), estate_related(s2));
@@ -2663,12 +2663,14 @@ void register_smatch_extra_late(int id)
 	add_merge_hook(link_id, &merge_link_states);
 	add_modification_hook(link_id, &match_link_modify);
 	add_hook(&match_dereferences, DEREF_HOOK);
-	add_hook(&match_pointer_as_array, OP_HOOK);
+	add_op_hook(&match_pointer_as_array, OP_HOOK, '*');
+	add_op_hook(&match_pointer_as_array, OP_HOOK, '(');
 	select_return_implies_hook(DEREFERENCE, &set_param_dereferenced);
 	add_hook(&match_function_call, FUNCTION_CALL_HOOK);
 	add_hook(&match_assign, ASSIGNMENT_HOOK);
 	add_hook(&match_assign, GLOBAL_ASSIGNMENT_HOOK);
-	add_hook(&unop_expr, OP_HOOK);
+	add_op_hook(&unop_expr, OP_HOOK, SPECIAL_INCREMENT);
+	add_op_hook(&unop_expr, OP_HOOK, SPECIAL_DECREMENT);
 	add_hook(&asm_expr, ASM_HOOK);
 
 	add_hook(&match_call_info, FUNCTION_CALL_HOOK);
@@ -119,6 +119,7 @@ struct smatch_state *clone_estate(struct smatch_state *state);
 struct smatch_state *clone_estate_cast(struct symbol *type, struct smatch_state *state);
 
 struct smatch_state *merge_estates(struct smatch_state *s1, struct smatch_state *s2);
+void clear_const_estate_cache(void);
 
 int estates_equiv(struct smatch_state *one, struct smatch_state *two);
 int estate_is_whole(struct smatch_state *state);
@@ -18,9 +18,115 @@
 #include <string.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <dirent.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "parse.h"
 #include "smatch.h"
 
+/*
+ * smatch --compile-data tokenizes every file in the data directory and
+ * writes the token streams to smatch_data.bundle.  get_tokens_file()
+ * maps the bundle and rebuilds the token list from it instead of
+ * running the tokenizer, as long as the text file still has the size
+ * and contents it had when the bundle was built.  The mtime is only a
+ * shortcut: when it changed (a copy or an install resets it), the
+ * contents are hashed and compared.  Anything else falls back to
+ * tokenizing the text file.
+ *
+ * The header records a hash of the on-disk format (the token types,
+ * the special operators and struct string), so a bundle keeps working
+ * with any smatch binary that agrees on those.
+ *
+ * The file index is a collision free hash table, so a lookup is one
+ * probe.  Numbers and strings point straight into the mapping and
+ * identifiers are hashed once per bundle entry.
+ *
+ * Every offset is checked against the size of the mapping before it is
+ * used, in load_bundle() for the header and the identifiers and in
+ * bundle_entry_ok() for the tokens of a file.  A bundle or an entry which
+ * fails the checks is ignored.
+ */
+#define DATA_BUNDLE_NAME "smatch_data.bundle"
+#define DATA_BUNDLE_MAGIC "SMDATA\0"
+#define DATA_BUNDLE_VERSION 2
+
+struct bundle_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t nr_files;
+	uint32_t hash_size;
+	uint32_t hash_seed;
+	uint32_t nr_idents;
+	uint32_t idents;	/* offset of the ident offsets */
+	uint32_t format;	/* bundle_format() of the writer */
+	uint32_t pad;
+};
+
+struct bundle_file {
+	uint32_t name;
+	uint32_t tokens;
+	uint32_t nr_tokens;
+	uint32_t pad;
+	int64_t size;
+	int64_t mtime;
+	int64_t mtime_nsec;
+	uint64_t hash;		/* of the file contents */
+};
+
+struct bundle_token {
+	unsigned char type;
+	unsigned char flags;
+	unsigned short pos;
+	uint32_t line;
+	uint32_t value;
+};
+
+#define BUNDLE_NEWLINE		1
+#define BUNDLE_WHITESPACE	2
+
+static uint32_t bundle_hash(const char *name, uint32_t seed)
+{
+	uint32_t hash = 2166136261u ^ seed;
+
+	while (*name)
+		hash = (hash ^ (unsigned char)*name++) * 16777619u;
+	return hash;
+}
+
+static uint32_t bundle_format(void)
+{
+	char buf[128];
+
+	snprintf(buf, sizeof(buf), "%d %d %d %d %d %zu %zu",
+		 DATA_BUNDLE_VERSION, TOKEN_STRING, TOKEN_SPECIAL, TOKEN_STREAMEND,
+		 SPECIAL_UNSIGNED_GTE, sizeof(struct string),
+		 sizeof(struct bundle_token));
+	return bundle_hash(buf, 0);
+}
+
+/* FNV-1a of the contents of "path", which should be "size" bytes long */
+static int hash_file(const char *path, int64_t size, uint64_t *hash)
+{
+	unsigned char buf[4096];
+	int64_t total = 0;
+	ssize_t len, i;
+	int fd;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return 0;
+	*hash = 14695981039346656037ull;
+	while ((len = read(fd, buf, sizeof(buf))) > 0) {
+		for (i = 0; i < len; i++)
+			*hash = (*hash ^ buf[i]) * 1099511628211ull;
+		total += len;
+	}
+	close(fd);
+	return len == 0 && total == size;
+}
+
 int open_data_file(const char *filename)
 {
 	char buf[256];
@@ -47,6 +153,241 @@ int open_schema_file(const char *schema)
 	return open(buf, O_RDONLY);
 }
 
+static const char *bundle;
+static size_t bundle_size;
+static struct ident **bundle_idents;
+static int bundle_loaded;
+
+/* a NUL terminated string starts at "offset" */
+static int bundle_str_ok(uint64_t offset)
+{
+	return offset < bundle_size &&
+	       memchr(bundle + offset, '\0', bundle_size - offset) != NULL;
+}
+
+/*
+ * The tables in the header must fit in the file and every identifier
+ * must be a string inside it.  Anything else means the bundle is
+ * truncated or corrupt and the text files are used instead.
+ */
+static int bundle_header_ok(const struct bundle_header *hdr)
+{
+	const uint32_t *offsets;
+	uint64_t end;
+	uint32_t i;
+
+	if (!hdr->hash_size || (hdr->hash_size & (hdr->hash_size - 1)))
+		return 0;
+	end = sizeof(*hdr) + (uint64_t)hdr->nr_files * sizeof(struct bundle_file) +
+	      (uint64_t)hdr->hash_size * sizeof(uint32_t);
+	if (end > bundle_size)
+		return 0;
+	if (hdr->idents % sizeof(uint32_t) ||
+	    hdr->idents + (uint64_t)hdr->nr_idents * sizeof(uint32_t) > bundle_size)
+		return 0;
+	offsets = (const void *)(bundle + hdr->idents);
+	for (i = 0; i < hdr->nr_idents; i++) {
+		if (!bundle_str_ok(offsets[i]))
+			return 0;
+	}
+	return 1;
+}
+
+static void load_bundle(void)
+{
+	const struct bundle_header *hdr;
+	char buf[256];
+	struct stat st;
+	void *map;
+	int fd;
+
+	bundle_loaded = 1;
+	if (!data_dir)
+		return;
+	snprintf(buf, sizeof(buf), "%s/%s", data_dir, DATA_BUNDLE_NAME);
+	fd = open(buf, O_RDONLY);
+	if (fd < 0)
+		return;
+	if (fstat(fd, &st) < 0 || st.st_size < sizeof(*hdr)) {
+		close(fd);
+		return;
+	}
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED)
+		return;
+
+	hdr = map;
+	bundle = map;
+	bundle_size = st.st_size;
+	if (memcmp(hdr->magic, DATA_BUNDLE_MAGIC, sizeof(hdr->magic)) != 0 ||
+	    hdr->version != DATA_BUNDLE_VERSION ||
+	    hdr->format != bundle_format() ||
+	    !bundle_header_ok(hdr)) {
+		munmap(map, st.st_size);
+		bundle = NULL;
+		bundle_size = 0;
+		return;
+	}
+	bundle_idents = calloc(hdr->nr_idents, sizeof(*bundle_idents));
+}
+
+static const struct bundle_file *bundle_lookup(const char *filename)
+{
+	const struct bundle_header *hdr = (const void *)bundle;
+	const struct bundle_file *files = (const void *)(hdr + 1);
+	const uint32_t *hash = (const void *)(files + hdr->nr_files);
+	uint32_t idx;
+
+	idx = hash[bundle_hash(filename, hdr->hash_seed) & (hdr->hash_size - 1)];
+	if (!idx || idx > hdr->nr_files || !bundle_str_ok(files[idx - 1].name) ||
+	    strcmp(bundle + files[idx - 1].name, filename) != 0)
+		return NULL;
+	return &files[idx - 1];
+}
+
+/* every token of "f" points at something inside the bundle */
+static int bundle_entry_ok(const struct bundle_file *f)
+{
+	const struct bundle_header *hdr = (const void *)bundle;
+	const struct bundle_token *bt;
+	const struct string *str;
+	uint32_t i;
+
+	if (f->tokens % __alignof__(struct bundle_token) ||
+	    f->tokens + (uint64_t)f->nr_tokens * sizeof(*bt) > bundle_size)
+		return 0;
+
+	bt = (const void *)(bundle + f->tokens);
+	for (i = 0; i < f->nr_tokens; i++, bt++) {
+		switch (bt->type) {
+		case TOKEN_IDENT:
+		case TOKEN_ZERO_IDENT:
+			if (bt->value >= hdr->nr_idents)
+				return 0;
+			break;
+		case TOKEN_NUMBER:
+			if (!bundle_str_ok(bt->value))
+				return 0;
+			break;
+		case TOKEN_SPECIAL:
+			break;
+		case TOKEN_CHAR:
+		case TOKEN_WIDE_CHAR:
+		case TOKEN_STRING:
+		case TOKEN_WIDE_STRING:
+			if (bt->value % __alignof__(struct string) ||
+			    bt->value + (uint64_t)sizeof(*str) > bundle_size)
+				return 0;
+			str = (const void *)(bundle + bt->value);
+			if (!str->length ||
+			    bt->value + sizeof(*str) + (uint64_t)str->length > bundle_size ||
+			    str->data[str->length - 1] != '\0')
+				return 0;
+			break;
+		case TOKEN_CHAR_EMBEDDED_0 ... TOKEN_CHAR_EMBEDDED_3:
+		case TOKEN_WIDE_CHAR_EMBEDDED_0 ... TOKEN_WIDE_CHAR_EMBEDDED_3:
+			break;
+		default:
+			return 0;
+		}
+	}
+	return 1;
+}
+
+static struct ident *bundle_ident(uint32_t nr)
+{
+	const struct bundle_header *hdr = (const void *)bundle;
+	const uint32_t *offsets = (const void *)(bundle + hdr->idents);
+
+	if (!bundle_idents[nr])
+		bundle_idents[nr] = built_in_ident(bundle + offsets[nr]);
+	return bundle_idents[nr];
+}
+
+static struct token *bundle_tokens(const char *filename)
+{
+	const struct bundle_token *bt;
+	const struct bundle_file *f;
+	struct token *begin, **next, *token;
+	char buf[256];
+	struct stat st;
+	uint64_t hash;
+	int stream;
+	uint32_t i;
+
+	if (!bundle_loaded)
+		load_bundle();
+	if (!bundle)
+		return NULL;
+	f = bundle_lookup(filename);
+	if (!f || !bundle_entry_ok(f))
+		return NULL;
+
+	snprintf(buf, sizeof(buf), "%s/%s", data_dir, filename);
+	if (stat(buf, &st) < 0 || st.st_size != f->size)
+		return NULL;
+	if (st.st_mtim.tv_sec != f->mtime || st.st_mtim.tv_nsec != f->mtime_nsec) {
+		if (!hash_file(buf, f->size, &hash) || hash != f->hash)
+			return NULL;
+	}
+
+	stream = init_stream(bundle + f->name, -1, NULL);
+
+	begin = __alloc_token(0);
+	begin->pos.stream = stream;
+	begin->pos.line = 1;
+	begin->pos.newline = 1;
+	token_type(begin) = TOKEN_STREAMBEGIN;
+	next = &begin->next;
+
+	bt = (const void *)(bundle + f->tokens);
+	for (i = 0; i < f->nr_tokens; i++, bt++) {
+		token = __alloc_token(0);
+		token->pos.stream = stream;
+		token->pos.type = bt->type;
+		token->pos.pos = bt->pos;
+		token->pos.line = bt->line;
+		token->pos.newline = !!(bt->flags & BUNDLE_NEWLINE);
+		token->pos.whitespace = !!(bt->flags & BUNDLE_WHITESPACE);
+
+		switch (bt->type) {
+		case TOKEN_IDENT:
+		case TOKEN_ZERO_IDENT:
+			token->ident = bundle_ident(bt->value);
+			break;
+		case TOKEN_NUMBER:
+			token->number = bundle + bt->value;
+			break;
+		case TOKEN_SPECIAL:
+			token->special = bt->value;
+			break;
+		case TOKEN_CHAR:
+		case TOKEN_WIDE_CHAR:
+		case TOKEN_STRING:
+		case TOKEN_WIDE_STRING:
+			token->string = (struct string *)(bundle + bt->value);
+			break;
+		default:
+			memcpy(token->embedded, &bt->value, sizeof(token->embedded));
+			break;
+		}
+		*next = token;
+		next = &token->next;
+	}
+
+	token = __alloc_token(0);
+	token->pos.stream = stream;
+	token->pos.newline = 1;
+	token_type(token) = TOKEN_STREAMEND;
+	eof_token_entry.next = &eof_token_entry;
+	eof_token_entry.pos.newline = 1;
+	token->next = &eof_token_entry;
+	*next = token;
+
+	return begin;
+}
+
 struct token *get_tokens_file(const char *filename)
 {
 	int fd;
@@ -54,10 +395,277 @@ struct token *get_tokens_file(const char *filename)
 
 	if (option_no_data)
 		return NULL;
-	fd = open_data_file(filename);
+	/* a file in the current directory overrides the data directory */
+	fd = open(filename, O_RDONLY);
+	if (fd < 0) {
+		token = bundle_tokens(filename);
+		if (token)
+			return token;
+		fd = open_data_file(filename);
+	}
 	if (fd < 0)
 		return NULL;
 	token = tokenize(filename, fd, NULL, NULL);
 	close(fd);
 	return token;
 }
+
+/*
+ * Writing the bundle.
+ */
+struct bundle_buf {
+	char *data;
+	size_t len, alloc;
+};
+
+static uint32_t buf_append(struct bundle_buf *b, const void *data, size_t len, size_t align)
+{
+	uint32_t offset;
+
+	while (b->len % align)
+		b->len++;
+	if (b->len + len > b->alloc) {
+		b->alloc = (b->len + len) * 2;
+		b->data = realloc(b->data, b->alloc);
+		if (!b->data)
+			die("out of memory writing %s", DATA_BUNDLE_NAME);
+	}
+	memcpy(b->data + b->len, data, len);
+	offset = b->len;
+	b->len += len;
+	return offset;
+}
+
+struct ident_slot {
+	struct ident *ident;
+	uint32_t nr;
+};
+
+static struct ident_slot *ident_slots;
+static uint32_t ident_slots_size, nr_idents;
+static struct bundle_buf ident_offsets;
+
+static uint32_t ident_nr(struct bundle_buf *blob, struct ident *ident)
+{
+	uint32_t i = ((uintptr_t)ident >> 4) & (ident_slots_size - 1);
+	uint32_t offset;
+	char name[256];
+
+	while (ident_slots[i].ident) {
+		if (ident_slots[i].ident == ident)
+			return ident_slots[i].nr;
+		i = (i + 1) & (ident_slots_size - 1);
+	}
+	if (nr_idents * 2 >= ident_slots_size)
+		die("too many identifiers for %s", DATA_BUNDLE_NAME);
+
+	snprintf(name, sizeof(name), "%.*s", ident->len, ident->name);
+	offset = buf_append(blob, name, strlen(name) + 1, 1);
+	buf_append(&ident_offsets, &offset, sizeof(offset), sizeof(offset));
+	ident_slots[i].ident = ident;
+	ident_slots[i].nr = nr_idents;
+	return nr_idents++;
+}
+
+static int add_bundle_file(struct bundle_buf *blob, struct bundle_file *f,
+			   const char *name, const struct stat *st)
+{
+	struct bundle_buf tokens = {};
+	struct token *token;
+	char path[256];
+	int fd;
+
+	snprintf(path, sizeof(path), "%s/%s", data_dir, name);
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return 0;
+	token = tokenize(name, fd, NULL, NULL);
+	close(fd);
+
+	memset(f, 0, sizeof(*f));
+	if (!hash_file(path, st->st_size, &f->hash))
+		return 0;
+	f->name = buf_append(blob, name, strlen(name) + 1, 1);
+	f->size = st->st_size;
+	f->mtime = st->st_mtim.tv_sec;
+	f->mtime_nsec = st->st_mtim.tv_nsec;
+
+	for (token = token->next; token_type(token) != TOKEN_STREAMEND; token = token->next) {
+		struct bundle_token bt = {};
+		struct string *str;
+
+		bt.type = token_type(token);
+		bt.pos = token->pos.pos;
+		bt.line = token->pos.line;
+		if (token->pos.newline)
+			bt.flags |= BUNDLE_NEWLINE;
+		if (token->pos.whitespace)
+			bt.flags |= BUNDLE_WHITESPACE;
+
+		switch (bt.type) {
+		case TOKEN_IDENT:
+		case TOKEN_ZERO_IDENT:
+			bt.value = ident_nr(blob, token->ident);
+			break;
+		case TOKEN_NUMBER:
+			bt.value = buf_append(blob, token->number, strlen(token->number) + 1, 1);
+			break;
+		case TOKEN_SPECIAL:
+			bt.value = token->special;
+			break;
+		case TOKEN_CHAR:
+		case TOKEN_WIDE_CHAR:
+		case TOKEN_STRING:
+		case TOKEN_WIDE_STRING:
+			str = malloc(sizeof(*str) + token->string->length);
+			memcpy(str, token->string, sizeof(*str) + token->string->length);
+			str->immutable = 1;
+			bt.value = buf_append(blob, str, sizeof(*str) + str->length,
+					      __alignof__(struct string));
+			free(str);
+			break;
+		case TOKEN_CHAR_EMBEDDED_0 ... TOKEN_CHAR_EMBEDDED_3:
+		case TOKEN_WIDE_CHAR_EMBEDDED_0 ... TOKEN_WIDE_CHAR_EMBEDDED_3:
+			memcpy(&bt.value, token->embedded, sizeof(bt.value));
+			break;
+		default:
+			free(tokens.data);
+			return 0;
+		}
+		buf_append(&tokens, &bt, sizeof(bt), 1);
+		f->nr_tokens++;
+	}
+	f->tokens = tokens.len ? buf_append(blob, tokens.data, tokens.len, sizeof(uint32_t)) : 0;
+	free(tokens.data);
+	return 1;
+}
+
+static int cmp_names(const void *a, const void *b)
+{
+	return strcmp(*(char * const *)a, *(char * const *)b);
+}
+
+/*
+ * Find a seed and a table size where every file name gets its own slot.
+ */
+static uint32_t *perfect_hash(char **names, int nr, uint32_t *size, uint32_t *seed)
+{
+	uint32_t *table;
+	int i;
+
+	for (*size = 16; *size < nr * 2; *size *= 2)
+		;
+	for (;; *size *= 2) {
+		table = calloc(*size, sizeof(*table));
+		for (*seed = 0; *seed < 64; (*seed)++) {
+			memset(table, 0, *size * sizeof(*table));
+			for (i = 0; i < nr; i++) {
+				uint32_t *slot = &table[bundle_hash(names[i], *seed) & (*size - 1)];
+
+				if (*slot)
+					break;
+				*slot = i + 1;
+			}
+			if (i == nr)
+				return table;
+		}
+		free(table);
+	}
+}
+
+int compile_data_bundle(void)
+{
+	struct bundle_buf blob = {}, out = {};
+	struct bundle_header hdr = {};
+	struct bundle_file *files;
+	struct dirent *de;
+	char **names = NULL;
+	uint32_t *hash;
+	char path[256], tmp[256];
+	int nr = 0, nr_files = 0, i;
+	DIR *dir;
+	FILE *f;
+
+	if (!data_dir)
+		die("no data directory");
+	dir = opendir(data_dir);
+	if (!dir)
+		die("cannot open %s", data_dir);
+	while ((de = readdir(dir))) {
+		if (de->d_name[0] == '.' ||
+		    strncmp(de->d_name, DATA_BUNDLE_NAME, strlen(DATA_BUNDLE_NAME)) == 0)
+			continue;
+		names = realloc(names, (nr + 1) * sizeof(*names));
+		names[nr++] = strdup(de->d_name);
+	}
+	closedir(dir);
+	qsort(names, nr, sizeof(*names), cmp_names);
+
+	ident_slots_size = 1 << 20;
+	ident_slots = calloc(ident_slots_size, sizeof(*ident_slots));
+	files = calloc(nr + 1, sizeof(*files));
+	for (i = 0; i < nr; i++) {
+		struct stat st;
+
+		snprintf(path, sizeof(path), "%s/%s", data_dir, names[i]);
+		if (stat(path, &st) < 0 || !S_ISREG(st.st_mode))
+			continue;
+		if (add_bundle_file(&blob, &files[nr_files], names[i], &st))
+			names[nr_files++] = names[i];
+	}
+
+	hash = perfect_hash(names, nr_files, &hdr.hash_size, &hdr.hash_seed);
+
+	memcpy(hdr.magic, DATA_BUNDLE_MAGIC, sizeof(hdr.magic));
+	hdr.version = DATA_BUNDLE_VERSION;
+	hdr.nr_files = nr_files;
+	hdr.nr_idents = nr_idents;
+	hdr.format = bundle_format();
+
+	/* everything in the blob is relative to the start of the bundle */
+	buf_append(&out, &hdr, sizeof(hdr), 8);
+	buf_append(&out, files, nr_files * sizeof(*files), 8);
+	buf_append(&out, hash, hdr.hash_size * sizeof(*hash), 8);
+	while (out.len % 8)
+		out.len++;
+	for (i = 0; i < nr_files; i++) {
+		files[i].name += out.len;
+		files[i].tokens += out.len;
+	}
+	for (i = 0; i < nr_idents; i++)
+		((uint32_t *)ident_offsets.data)[i] += out.len;
+	/* fix up the offsets inside the token records */
+	for (i = 0; i < nr_files; i++) {
+		struct bundle_token *bt = (void *)(blob.data + files[i].tokens - out.len);
+		uint32_t j;
+
+		for (j = 0; j < files[i].nr_tokens; j++, bt++) {
+			switch (bt->type) {
+			case TOKEN_NUMBER:
+			case TOKEN_CHAR:
+			case TOKEN_WIDE_CHAR:
+			case TOKEN_STRING:
+			case TOKEN_WIDE_STRING:
+				bt->value += out.len;
+				break;
+			}
+		}
+	}
+	hdr.idents = out.len + buf_append(&blob, ident_offsets.data, ident_offsets.len, sizeof(uint32_t));
+
+	out.len = 0;
+	buf_append(&out, &hdr, sizeof(hdr), 8);
+	buf_append(&out, files, nr_files * sizeof(*files), 8);
+	buf_append(&out, hash, hdr.hash_size * sizeof(*hash), 8);
+	buf_append(&out, blob.data, blob.len, 8);
+
+	snprintf(tmp, sizeof(tmp), "%s/%s.tmp", data_dir, DATA_BUNDLE_NAME);
+	snprintf(path, sizeof(path), "%s/%s", data_dir, DATA_BUNDLE_NAME);
+	f = fopen(tmp, "w");
+	if (!f || fwrite(out.data, out.len, 1, f) != 1 || fclose(f) != 0 ||
+	    rename(tmp, path) != 0)
+		die("cannot write %s", path);
+	printf("%s: %d files, %u identifiers, %zu bytes\n", path, nr_files,
+	       nr_idents, out.len);
+	return 0;
+}
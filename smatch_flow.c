@@ -1943,7 +1943,8 @@ void smatch(int argc, char **argv)
 		}
 		if (option_file_output)
 			open_output_files(base_file);
-		sym_list = sparse_keep_tokens(base_file);
+		sym_list = __sparse(base_file);
+		__select_active_checks();
 		split_c_file_functions(sym_list);
 	} END_FOR_EACH_PTR_NOTAG(base_file);
 
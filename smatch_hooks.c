@@ -27,15 +27,42 @@ enum data_type {
 struct hook_container {
 	int hook_type;
 	enum data_type data_type;
+	int owner;
+	int key;
 	void *fn;
 };
 ALLOCATOR(hook_container, "hook functions");
 DECLARE_PTR_LIST(hook_func_list, struct hook_container);
 static struct hook_func_list *merge_funcs;
 static struct hook_func_list *unmatched_state_funcs;
+static struct hook_func_list *all_hooks[NUM_HOOKS] = {};
 static struct hook_func_list *hook_array[NUM_HOOKS] = {};
 void (**pre_merge_hooks)(struct sm_state *sm);
 
+/*
+ * Most expression hooks only care about one expr->type or expr->op.  Those
+ * can subscribe with add_expr_type_hook() or add_op_hook().  If any hook is
+ * keyed for a given type/op then keyed_hooks[type][key] holds every hook
+ * which wants to see it (keyed or not) in registration order.  Otherwise
+ * hook_array[] only holds the hooks which take everything.
+ */
+#define NUM_HOOK_KEYS (SPECIAL_UNSIGNED_GTE + 1)
+static struct hook_func_list **keyed_hooks[NUM_HOOKS];
+static int hooks_changed;
+
+/*
+ * Some checks are only interesting if the file uses a specific function or
+ * macro.  They can list those identifiers with add_check_trigger() and then
+ * their hooks are left out of hook_array[] for files where none of the
+ * triggers were used.  A trigger counts as used when it is expanded as a
+ * macro or appears in an expression, so a prototype in a header doesn't
+ * turn the check on.  The ident->seen flags are cleared after each file.
+ * --debug=<check> prints whether the check is active for each file.
+ */
+int __registering_check;
+static struct ident_list **check_triggers;
+static unsigned char *check_active;
+
 struct scope_container {
 	void *fn;
 	void *data;
@@ -161,7 +188,155 @@ void add_hook(void *func, enum hook_type type)
 		container->data_type = SYM_LIST_PTR;
 		break;
 	}
-	add_ptr_list(&hook_array[type], container);
+	container->owner = __registering_check;
+	container->key = -1;
+	add_ptr_list(&all_hooks[type], container);
+	hooks_changed = 1;
+}
+
+static int is_keyed_type(enum hook_type type)
+{
+	switch (type) {
+	case EXPR_HOOK:
+	case LOGIC_HOOK:
+	case BINOP_HOOK:
+	case OP_HOOK:
+		return 1;
+	default:
+		return 0;
+	}
+}
+
+static void add_keyed_hook(void *func, enum hook_type type, int key)
+{
+	struct hook_container *container;
+
+	if (!is_keyed_type(type) || key < 0 || key >= NUM_HOOK_KEYS) {
+		sm_msg("internal: hook type %d can't be keyed on %d", type, key);
+		return;
+	}
+
+	add_hook(func, type);
+	container = last_ptr_list((struct ptr_list *)all_hooks[type]);
+	container->key = key;
+}
+
+void add_expr_type_hook(void *func, enum expression_type expr_type)
+{
+	add_keyed_hook(func, EXPR_HOOK, expr_type);
+}
+
+void add_op_hook(void *func, enum hook_type type, int op)
+{
+	add_keyed_hook(func, type, op);
+}
+
+void add_check_trigger(int owner, const char *name)
+{
+	add_ident(&check_triggers[owner], built_in_ident(name));
+}
+
+static int triggered(int owner)
+{
+	struct ident *ident;
+
+	if (!check_triggers[owner])
+		return 1;
+	FOR_EACH_PTR(check_triggers[owner], ident) {
+		if (ident->seen)
+			return 1;
+	} END_FOR_EACH_PTR(ident);
+	return 0;
+}
+
+static void clear_check_triggers(void)
+{
+	struct ident *ident;
+	int i;
+
+	for (i = 0; i <= num_checks; i++) {
+		FOR_EACH_PTR(check_triggers[i], ident) {
+			ident->seen = 0;
+		} END_FOR_EACH_PTR(ident);
+	}
+}
+
+void __select_active_checks(void)
+{
+	int active;
+	int i;
+
+	for (i = 0; i <= num_checks; i++) {
+		active = triggered(i);
+		if (active != check_active[i])
+			hooks_changed = 1;
+		check_active[i] = active;
+		if (check_triggers[i] && strcmp(check_name(i), option_debug_check) == 0)
+			fprintf(sm_outfd, "%s: %s\n", check_name(i),
+				active ? "active" : "inactive");
+	}
+	clear_check_triggers();
+}
+
+static void build_keyed_hooks(enum hook_type type)
+{
+	struct hook_container *container, *tmp;
+	int key;
+
+	if (keyed_hooks[type]) {
+		for (key = 0; key < NUM_HOOK_KEYS; key++)
+			__free_ptr_list((struct ptr_list **)&keyed_hooks[type][key]);
+	}
+
+	FOR_EACH_PTR(all_hooks[type], container) {
+		if (container->key < 0 || !check_active[container->owner])
+			continue;
+		if (!keyed_hooks[type])
+			keyed_hooks[type] = calloc(NUM_HOOK_KEYS, sizeof(*keyed_hooks[type]));
+		key = container->key;
+		if (keyed_hooks[type][key])
+			continue;
+		FOR_EACH_PTR(all_hooks[type], tmp) {
+			if (!check_active[tmp->owner])
+				continue;
+			if (tmp->key < 0 || tmp->key == key)
+				add_ptr_list(&keyed_hooks[type][key], tmp);
+		} END_FOR_EACH_PTR(tmp);
+	} END_FOR_EACH_PTR(container);
+}
+
+static void build_hook_lists(void)
+{
+	struct hook_container *container;
+	int i;
+
+	for (i = 0; i < NUM_HOOKS; i++) {
+		__free_ptr_list((struct ptr_list **)&hook_array[i]);
+		FOR_EACH_PTR(all_hooks[i], container) {
+			if (container->key < 0 && check_active[container->owner])
+				add_ptr_list(&hook_array[i], container);
+		} END_FOR_EACH_PTR(container);
+		if (is_keyed_type(i))
+			build_keyed_hooks(i);
+	}
+	hooks_changed = 0;
+}
+
+static struct hook_func_list *get_hook_list(void *data, enum hook_type type)
+{
+	struct expression *expr = data;
+	int key;
+
+	if (hooks_changed)
+		build_hook_lists();
+
+	if (!keyed_hooks[type])
+		return hook_array[type];
+
+	key = (type == EXPR_HOOK) ? expr->type : expr->op;
+	if (key < 0 || key >= NUM_HOOK_KEYS || !keyed_hooks[type][key])
+		return hook_array[type];
+	return keyed_hooks[type][key];
 }
 
 void add_merge_hook(int client_id, merge_func_t *func)
@@ -219,8 +394,7 @@ void __pass_to_client(void *data, enum hook_type type)
 {
 	struct hook_container *container;
 
-
-	FOR_EACH_PTR(hook_array[type], container) {
+	FOR_EACH_PTR(get_hook_list(data, type), container) {
 		switch (container->data_type) {
 		case EXPR_PTR:
 			pass_expr_to_client(container->fn, data);
@@ -242,6 +416,9 @@ void __pass_to_client_no_data(enum hook_type type)
 {
 	struct hook_container *container;
 
+	if (hooks_changed)
+		build_hook_lists();
+
 	FOR_EACH_PTR(hook_array[type], container) {
 		pass_to_client(container->fn);
 	} END_FOR_EACH_PTR(container);
@@ -254,6 +431,9 @@ void __pass_case_to_client(struct expression *switch_expr,
 				 struct range_list *rl);
 	struct hook_container *container;
 
+	if (hooks_changed)
+		build_hook_lists();
+
 	FOR_EACH_PTR(hook_array[CASE_HOOK], container) {
 		((case_func *) container->fn)(switch_expr, rl);
 	} END_FOR_EACH_PTR(container);
@@ -364,5 +544,8 @@ void allocate_hook_memory(void)
 {
 	pre_merge_hooks = malloc(num_checks * sizeof(*pre_merge_hooks));
 	memset(pre_merge_hooks, 0, num_checks * sizeof(*pre_merge_hooks));
+	check_triggers = calloc(num_checks + 1, sizeof(*check_triggers));
+	check_active = malloc(num_checks + 1);
+	memset(check_active, 1, num_checks + 1);
 }
 
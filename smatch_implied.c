@@ -825,17 +825,15 @@ static void separate_extra_states(struct stree **implied_true,
 	struct sm_state *sm;
 
 	/* We process extra states later to preserve the implications. */
-	FOR_EACH_SM(*implied_true, sm) {
-		if (sm->owner == SMATCH_EXTRA)
-			overwrite_sm_state_stree(&extra_saved_implied_true, sm);
+	FOR_EACH_MY_SM(SMATCH_EXTRA, *implied_true, sm) {
+		overwrite_sm_state_stree(&extra_saved_implied_true, sm);
 	} END_FOR_EACH_SM(sm);
 	FOR_EACH_SM(extra_saved_implied_true, sm) {
 		delete_state_stree(implied_true, sm->owner, sm->name, sm->sym);
 	} END_FOR_EACH_SM(sm);
 
-	FOR_EACH_SM(*implied_false, sm) {
-		if (sm->owner == SMATCH_EXTRA)
-			overwrite_sm_state_stree(&extra_saved_implied_false, sm);
+	FOR_EACH_MY_SM(SMATCH_EXTRA, *implied_false, sm) {
+		overwrite_sm_state_stree(&extra_saved_implied_false, sm);
 	} END_FOR_EACH_SM(sm);
 	FOR_EACH_SM(extra_saved_implied_false, sm) {
 		delete_state_stree(implied_false, sm->owner, sm->name, sm->sym);
@@ -126,19 +126,16 @@ static void process_states(void)
 	struct smatch_state *extra;
 	struct range_list *rl;
 
-	FOR_EACH_SM(__get_cur_stree(), sm) {
-		if (sm->owner != my_id)
-			continue;
+	FOR_EACH_MY_SM(my_id, __get_cur_stree(), sm) {
 		extra = get_state(SMATCH_EXTRA, sm->name, sm->sym);
 		if (extra && estate_rl(extra))
 			rl = rl_intersection(estate_rl(sm->state), estate_rl(extra));
 		else
 			rl = estate_rl(sm->state);
 		rl = cast_rl(&llong_ctype, rl);
-		mem_sql(NULL, NULL,
-			"insert into local_values values ('%s', '%s', '%s', %lu);",
-			get_filename(), sm->name, show_rl(rl),
-			(unsigned long)sm->sym);
+		mem_insert(mem_local_values, "%s %s %s %lu",
+			   get_filename(), sm->name, show_rl(rl),
+			   (unsigned long)sm->sym);
 	} END_FOR_EACH_SM(sm);
 }
 
@@ -221,8 +218,8 @@ static int save_final_values(void *unused, int argc, char **argv, char **azColNa
 
 static void match_end_file(struct symbol_list *sym_list)
 {
-	mem_sql(save_final_values, NULL,
-		"select distinct variable, symbol, value from local_values order by variable;");
+	mem_select(mem_local_values, "distinct variable, symbol, value", "variable",
+		   save_final_values, NULL, NULL);
 	if (cur_name)
 		add_current_local();
 }
@@ -239,5 +236,4 @@ void register_local_values(int id)
 	add_merge_hook(my_id, &merge_estates);
 	all_return_states_hook(&process_states);
 	add_hook(match_end_file, END_FILE_HOOK);
-	mem_sql(NULL, NULL, "alter table local_values add column symbol integer;");
 }
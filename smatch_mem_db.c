@@ -0,0 +1,627 @@
+/*
+ * Copyright (C) 2010 Dan Carpenter.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see http://www.gnu.org/copyleft/gpl.txt
+ */
+
+/*
+ * The in-memory tables hold data which never leaves the process: the
+ * summaries of inline functions and the type_info/mtag_data/sink_info cache
+ * which is printed at the end of the file.  These used to be SQLite
+ * ":memory:" databases but formatting and parsing SQL for every insert was a
+ * waste of time.
+ *
+ * Every table is a list of rows in insertion order plus a hash on the "key"
+ * columns.  The query functions take the same sqlite3_exec() style callback
+ * as run_sql() so the callers didn't have to change.  The where clauses are
+ * a small subset of SQL: "col = %fmt and col = %fmt".  If every key column is
+ * in the where clause then we look the rows up in the hash, otherwise we scan
+ * the whole table.
+ *
+ */
+
+#include <stdarg.h>
+#include <string.h>
+#include "smatch.h"
+
+#define MEM_MAX_COLS 16
+#define MEM_INIT_HASH_BITS 8
+
+struct mem_row {
+	struct mem_row *prev, *next;
+	struct mem_row *hash_next;
+	unsigned int hash;
+	unsigned long seq;
+	char *vals[];
+};
+
+struct mem_bucket {
+	struct mem_row *head, *tail;
+};
+
+struct mem_table {
+	const char *name;
+	int ncols;
+	char *col_names[MEM_MAX_COLS];
+	int nkeys;
+	int keys[MEM_MAX_COLS];
+	int nunique;
+	int unique[MEM_MAX_COLS];
+
+	int hash_bits;
+	struct mem_bucket *buckets;
+	struct mem_row *head, *tail;
+	unsigned long count;
+	unsigned long seq;
+};
+
+int mem_db_open;
+
+struct mem_table *mem_caller_info;
+struct mem_table *mem_return_states;
+struct mem_table *mem_return_implies;
+struct mem_table *mem_call_implies;
+struct mem_table *mem_local_values;
+struct mem_table *mem_mtag_data;
+
+struct mem_table *cache_type_info;
+struct mem_table *cache_mtag_data;
+struct mem_table *cache_sink_info;
+
+static int split_names(const char *str, char **names, int max)
+{
+	char buf[256];
+	char *p, *start;
+	int cnt = 0;
+
+	snprintf(buf, sizeof(buf), "%s", str);
+	p = buf;
+	while (*p) {
+		while (*p == ' ' || *p == ',')
+			p++;
+		if (!*p)
+			break;
+		start = p;
+		while (*p && *p != ' ' && *p != ',')
+			p++;
+		if (*p)
+			*p++ = '\0';
+		if (cnt == max)
+			break;
+		names[cnt++] = alloc_string(start);
+	}
+	return cnt;
+}
+
+static int get_col_idx(struct mem_table *table, const char *name, int len)
+{
+	int i;
+
+	for (i = 0; i < table->ncols; i++) {
+		if (strncmp(table->col_names[i], name, len) == 0 &&
+		    table->col_names[i][len] == '\0')
+			return i;
+	}
+	fprintf(stderr, "mem table '%s' has no column '%.*s'\n", table->name, len, name);
+	return -1;
+}
+
+static int names_to_cols(struct mem_table *table, const char *names, int *cols)
+{
+	char *tmp[MEM_MAX_COLS];
+	int cnt, i;
+
+	if (!names)
+		return 0;
+	if (strcmp(names, "*") == 0) {
+		for (i = 0; i < table->ncols; i++)
+			cols[i] = i;
+		return table->ncols;
+	}
+
+	cnt = split_names(names, tmp, MEM_MAX_COLS);
+	for (i = 0; i < cnt; i++) {
+		cols[i] = get_col_idx(table, tmp[i], strlen(tmp[i]));
+		free_string(tmp[i]);
+		if (cols[i] < 0)
+			return -1;
+	}
+	return cnt;
+}
+
+struct mem_table *alloc_mem_table(const char *name, const char *columns,
+				  const char *key, const char *unique)
+{
+	struct mem_table *table;
+
+	table = calloc(1, sizeof(*table));
+	table->name = name;
+	table->ncols = split_names(columns, table->col_names, MEM_MAX_COLS);
+	table->nkeys = names_to_cols(table, key, table->keys);
+	table->nunique = names_to_cols(table, unique, table->unique);
+	table->hash_bits = MEM_INIT_HASH_BITS;
+	table->buckets = calloc(1 << table->hash_bits, sizeof(struct mem_bucket));
+
+	return table;
+}
+
+static unsigned int hash_vals(struct mem_table *table, char **vals)
+{
+	unsigned int hash = 2166136261u;
+	const unsigned char *p;
+	int i;
+
+	for (i = 0; i < table->nkeys; i++) {
+		for (p = (unsigned char *)vals[table->keys[i]]; *p; p++)
+			hash = (hash ^ *p) * 16777619u;
+		hash = (hash ^ 0xff) * 16777619u;
+	}
+	return hash;
+}
+
+static struct mem_bucket *get_bucket(struct mem_table *table, unsigned int hash)
+{
+	return &table->buckets[hash & ((1 << table->hash_bits) - 1)];
+}
+
+static void add_to_bucket(struct mem_table *table, struct mem_row *row)
+{
+	struct mem_bucket *bucket = get_bucket(table, row->hash);
+
+	row->hash_next = NULL;
+	if (bucket->tail)
+		bucket->tail->hash_next = row;
+	else
+		bucket->head = row;
+	bucket->tail = row;
+}
+
+static void grow_table(struct mem_table *table)
+{
+	struct mem_row *row;
+
+	free(table->buckets);
+	table->hash_bits++;
+	table->buckets = calloc(1 << table->hash_bits, sizeof(struct mem_bucket));
+	/* walking in insertion order keeps every chain in insertion order */
+	for (row = table->head; row; row = row->next)
+		add_to_bucket(table, row);
+}
+
+/*
+ * Converts the printf() style arguments to strings.  The only conversions
+ * supported are %s, %d, %u and their l/ll variants.  Every conversion goes
+ * into its own buffer in bufs[] unless it's a %s.
+ */
+static int format_args(const char *fmt, va_list *args, char **vals, char bufs[][32], int max)
+{
+	const char *p = fmt;
+	int longs;
+	int cnt = 0;
+
+	while ((p = strchr(p, '%'))) {
+		p++;
+		if (cnt == max)
+			return -1;
+		if (*p == 's') {
+			vals[cnt] = va_arg(*args, char *);
+			if (!vals[cnt])
+				vals[cnt] = (char *)"";
+			cnt++;
+			p++;
+			continue;
+		}
+		longs = 0;
+		while (*p == 'l') {
+			longs++;
+			p++;
+		}
+		if (*p == 'd') {
+			if (longs == 0)
+				snprintf(bufs[cnt], 32, "%d", va_arg(*args, int));
+			else if (longs == 1)
+				snprintf(bufs[cnt], 32, "%ld", va_arg(*args, long));
+			else
+				snprintf(bufs[cnt], 32, "%lld", va_arg(*args, long long));
+		} else if (*p == 'u') {
+			if (longs == 0)
+				snprintf(bufs[cnt], 32, "%u", va_arg(*args, unsigned int));
+			else if (longs == 1)
+				snprintf(bufs[cnt], 32, "%lu", va_arg(*args, unsigned long));
+			else
+				snprintf(bufs[cnt], 32, "%llu", va_arg(*args, unsigned long long));
+		} else {
+			fprintf(stderr, "mem table: unsupported format '%s'\n", fmt);
+			return -1;
+		}
+		vals[cnt] = bufs[cnt];
+		cnt++;
+		p++;
+	}
+	return cnt;
+}
+
+struct mem_where {
+	int nr;
+	int cols[MEM_MAX_COLS];
+	char *vals[MEM_MAX_COLS];
+	char bufs[MEM_MAX_COLS][32];
+	int use_hash;
+	unsigned int hash;
+};
+
+/* parses "col = %fmt and col = %fmt" */
+static int parse_where(struct mem_table *table, struct mem_where *where,
+		       const char *clause, va_list *args)
+{
+	char *key_vals[MEM_MAX_COLS];
+	const char *p, *start;
+	int i, j;
+
+	where->nr = 0;
+	where->use_hash = 0;
+	if (!clause)
+		return 0;
+
+	if (format_args(clause, args, where->vals, where->bufs, MEM_MAX_COLS) < 0)
+		return -1;
+
+	p = clause;
+	while (*p) {
+		while (*p == ' ')
+			p++;
+		if (strncmp(p, "and ", 4) == 0)
+			p += 4;
+		while (*p == ' ')
+			p++;
+		if (!*p)
+			break;
+		start = p;
+		while (*p && *p != ' ' && *p != '=')
+			p++;
+		where->cols[where->nr] = get_col_idx(table, start, p - start);
+		if (where->cols[where->nr] < 0)
+			return -1;
+		where->nr++;
+		while (*p && *p != '%')
+			p++;
+		while (*p && *p != ' ')
+			p++;
+	}
+
+	if (!table->nkeys)
+		return 0;
+	for (i = 0; i < table->nkeys; i++) {
+		for (j = 0; j < where->nr; j++) {
+			if (where->cols[j] == table->keys[i])
+				break;
+		}
+		if (j == where->nr)
+			return 0;
+		key_vals[table->keys[i]] = where->vals[j];
+	}
+	where->use_hash = 1;
+	where->hash = hash_vals(table, key_vals);
+	return 0;
+}
+
+static int row_matches(struct mem_row *row, struct mem_where *where)
+{
+	int i;
+
+	for (i = 0; i < where->nr; i++) {
+		if (strcmp(row->vals[where->cols[i]], where->vals[i]) != 0)
+			return 0;
+	}
+	return 1;
+}
+
+#define FOR_EACH_MATCHING_ROW(table, where, row)				\
+	for (row = (where)->use_hash ? get_bucket(table, (where)->hash)->head : (table)->head; \
+	     row;								\
+	     row = (where)->use_hash ? row->hash_next : row->next)		\
+		if (((where)->use_hash && row->hash != (where)->hash) ||	\
+		    !row_matches(row, where))					\
+			continue;						\
+		else
+
+static int is_duplicate(struct mem_table *table, struct mem_row *new)
+{
+	struct mem_row *row;
+	int i;
+
+	for (row = get_bucket(table, new->hash)->head; row; row = row->hash_next) {
+		if (row->hash != new->hash)
+			continue;
+		for (i = 0; i < table->nunique; i++) {
+			if (strcmp(row->vals[table->unique[i]],
+				   new->vals[table->unique[i]]) != 0)
+				break;
+		}
+		if (i == table->nunique)
+			return 1;
+	}
+	return 0;
+}
+
+void mem_insert(struct mem_table *table, const char *fmt, ...)
+{
+	char bufs[MEM_MAX_COLS][32];
+	char *vals[MEM_MAX_COLS];
+	struct mem_row *row;
+	va_list args;
+	size_t size;
+	char *p;
+	int i;
+
+	if (!table)
+		return;
+
+	va_start(args, fmt);
+	i = format_args(fmt, &args, vals, bufs, MEM_MAX_COLS);
+	va_end(args);
+	if (i != table->ncols) {
+		fprintf(stderr, "mem table '%s': %d values for %d columns\n",
+			table->name, i, table->ncols);
+		return;
+	}
+
+	size = sizeof(*row) + table->ncols * sizeof(char *);
+	for (i = 0; i < table->ncols; i++)
+		size += strlen(vals[i]) + 1;
+	row = malloc(size);
+	p = (char *)&row->vals[table->ncols];
+	for (i = 0; i < table->ncols; i++) {
+		row->vals[i] = p;
+		p = stpcpy(p, vals[i]) + 1;
+	}
+	row->hash = hash_vals(table, row->vals);
+
+	if (table->nunique && is_duplicate(table, row)) {
+		free(row);
+		return;
+	}
+
+	row->seq = table->seq++;
+	row->next = NULL;
+	row->prev = table->tail;
+	if (table->tail)
+		table->tail->next = row;
+	else
+		table->head = row;
+	table->tail = row;
+	add_to_bucket(table, row);
+
+	if (++table->count > (2UL << table->hash_bits))
+		grow_table(table);
+}
+
+static void delete_row(struct mem_table *table, struct mem_row *row)
+{
+	struct mem_bucket *bucket = get_bucket(table, row->hash);
+	struct mem_row *tmp, *prev = NULL;
+
+	for (tmp = bucket->head; tmp != row; tmp = tmp->hash_next)
+		prev = tmp;
+	if (prev)
+		prev->hash_next = row->hash_next;
+	else
+		bucket->head = row->hash_next;
+	if (bucket->tail == row)
+		bucket->tail = prev;
+
+	if (row->prev)
+		row->prev->next = row->next;
+	else
+		table->head = row->next;
+	if (row->next)
+		row->next->prev = row->prev;
+	else
+		table->tail = row->prev;
+
+	table->count--;
+	free(row);
+}
+
+void mem_delete(struct mem_table *table, const char *clause, ...)
+{
+	struct mem_where where;
+	struct mem_row *row, *next;
+	va_list args;
+	int ret;
+
+	if (!table)
+		return;
+
+	if (!clause) {
+		for (row = table->head; row; row = next) {
+			next = row->next;
+			free(row);
+		}
+		table->head = table->tail = NULL;
+		memset(table->buckets, 0, (1 << table->hash_bits) * sizeof(struct mem_bucket));
+		table->count = 0;
+		return;
+	}
+
+	va_start(args, clause);
+	ret = parse_where(table, &where, clause, &args);
+	va_end(args);
+	if (ret < 0)
+		return;
+
+	row = where.use_hash ? get_bucket(table, where.hash)->head : table->head;
+	for (; row; row = next) {
+		next = where.use_hash ? row->hash_next : row->next;
+		if (row_matches(row, &where))
+			delete_row(table, row);
+	}
+}
+
+static int compare_vals(const char *a, const char *b)
+{
+	long long x, y;
+	char *end_a, *end_b;
+
+	/* integer columns sort numerically, the same as SQLite */
+	x = strtoll(a, &end_a, 10);
+	y = strtoll(b, &end_b, 10);
+	if (end_a != a && !*end_a && end_b != b && !*end_b) {
+		if (x != y)
+			return x < y ? -1 : 1;
+		return 0;
+	}
+	return strcmp(a, b);
+}
+
+static int sort_ncols;
+static int sort_cols[2 * MEM_MAX_COLS];
+
+static int compare_rows(const void *_a, const void *_b)
+{
+	struct mem_row *a = *(struct mem_row **)_a;
+	struct mem_row *b = *(struct mem_row **)_b;
+	int ret;
+	int i;
+
+	for (i = 0; i < sort_ncols; i++) {
+		ret = compare_vals(a->vals[sort_cols[i]], b->vals[sort_cols[i]]);
+		if (ret)
+			return ret;
+	}
+	if (a->seq == b->seq)
+		return 0;
+	return a->seq < b->seq ? -1 : 1;
+}
+
+static int same_cols(struct mem_row *a, struct mem_row *b, int *cols, int ncols)
+{
+	int i;
+
+	for (i = 0; i < ncols; i++) {
+		if (strcmp(a->vals[cols[i]], b->vals[cols[i]]) != 0)
+			return 0;
+	}
+	return 1;
+}
+
+/*
+ * "cols" is the list of columns to pass to the callback, optionally starting
+ * with "distinct ".  "order" is a list of columns to sort on.  Rows are
+ * otherwise returned in the order they were inserted.
+ */
+void mem_select(struct mem_table *table, const char *cols, const char *order,
+		int (*callback)(void*, int, char**, char**), void *data,
+		const char *clause, ...)
+{
+	char *argv[MEM_MAX_COLS], *names[MEM_MAX_COLS];
+	int select_cols[MEM_MAX_COLS];
+	int order_cols[MEM_MAX_COLS];
+	struct mem_row **rows;
+	struct mem_where where;
+	struct mem_row *row;
+	int nr_select, nr_order;
+	int distinct = 0;
+	va_list args;
+	int nr = 0, kept;
+	int ret;
+	int i, j;
+
+	if (!table)
+		return;
+
+	va_start(args, clause);
+	ret = parse_where(table, &where, clause, &args);
+	va_end(args);
+	if (ret < 0)
+		return;
+
+	if (strncmp(cols, "distinct ", 9) == 0) {
+		distinct = 1;
+		cols += 9;
+	}
+	nr_select = names_to_cols(table, cols, select_cols);
+	nr_order = names_to_cols(table, order, order_cols);
+	if (nr_select < 0 || nr_order < 0)
+		return;
+
+	rows = malloc((table->count + 1) * sizeof(*rows));
+	FOR_EACH_MATCHING_ROW(table, &where, row)
+		rows[nr++] = row;
+
+	if (distinct) {
+		/* keep the first row of each group of duplicates */
+		sort_ncols = 0;
+		for (i = 0; i < nr_select; i++)
+			sort_cols[sort_ncols++] = select_cols[i];
+		qsort(rows, nr, sizeof(*rows), compare_rows);
+		kept = 0;
+		for (i = 0; i < nr; i++) {
+			if (kept && same_cols(rows[kept - 1], rows[i], select_cols, nr_select))
+				continue;
+			rows[kept++] = rows[i];
+		}
+		nr = kept;
+	}
+	if (nr_order || distinct) {
+		sort_ncols = 0;
+		for (i = 0; i < nr_order; i++)
+			sort_cols[sort_ncols++] = order_cols[i];
+		qsort(rows, nr, sizeof(*rows), compare_rows);
+	}
+
+	for (i = 0; i < nr_select; i++)
+		names[i] = table->col_names[select_cols[i]];
+	for (i = 0; i < nr; i++) {
+		for (j = 0; j < nr_select; j++)
+			argv[j] = rows[i]->vals[select_cols[j]];
+		if (callback(data, nr_select, argv, names))
+			break;
+	}
+	free(rows);
+}
+
+void init_mem_db(void)
+{
+	mem_caller_info = alloc_mem_table("caller_info",
+			"file, caller, function, call_id, static, type, parameter, key, value",
+			"call_id", NULL);
+	mem_return_states = alloc_mem_table("return_states",
+			"file, function, call_id, return_id, return, static, type, parameter, key, value",
+			"call_id", NULL);
+	mem_return_implies = alloc_mem_table("return_implies",
+			"file, function, call_id, static, type, parameter, key, value",
+			"call_id", "*");
+	mem_call_implies = alloc_mem_table("call_implies",
+			"file, function, call_id, static, type, parameter, key, value",
+			"call_id", "*");
+	mem_local_values = alloc_mem_table("local_values",
+			"file, variable, value, symbol",
+			"variable", NULL);
+	mem_mtag_data = alloc_mem_table("mtag_data",
+			"tag, offset, type, value",
+			"tag, offset", NULL);
+
+	cache_type_info = alloc_mem_table("type_info",
+			"file, type, key, value",
+			"type, key, value", "type, key, value");
+	cache_mtag_data = alloc_mem_table("mtag_data",
+			"tag, offset, type, value",
+			"tag, offset", NULL);
+	cache_sink_info = alloc_mem_table("sink_info",
+			"file, static, sink_name, type, key, value",
+			"sink_name, type", NULL);
+
+	mem_db_open = 1;
+}
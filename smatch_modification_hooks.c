@@ -289,7 +289,8 @@ void register_modification_hooks(int id)
 	memset(hooks_late, 0, (num_checks + 1) * sizeof(*hooks));
 
 	add_hook(&match_assign_early, ASSIGNMENT_HOOK);
-	add_hook(&unop_expr_early, OP_HOOK);
+	add_op_hook(&unop_expr_early, OP_HOOK, SPECIAL_INCREMENT);
+	add_op_hook(&unop_expr_early, OP_HOOK, SPECIAL_DECREMENT);
 	add_hook(&asm_expr_early, ASM_HOOK);
 }
 
@@ -301,7 +302,8 @@ void register_modification_hooks_late(int id)
 	select_return_states_hook(PARAM_SET, &db_param_add);
 
 	add_hook(&match_assign_late, ASSIGNMENT_HOOK_AFTER);
-	add_hook(&unop_expr_late, OP_HOOK);
+	add_op_hook(&unop_expr_late, OP_HOOK, SPECIAL_INCREMENT);
+	add_op_hook(&unop_expr_late, OP_HOOK, SPECIAL_DECREMENT);
 	add_hook(&asm_expr_late, ASM_HOOK);
 }
 
@@ -42,8 +42,8 @@ static struct range_list *select_orig_rl(sval_t sval)
 	mtag_t tag = sval.uvalue & ~MTAG_OFFSET_MASK;
 	int offset = sval.uvalue & MTAG_OFFSET_MASK;
 
-	mem_sql(&save_rl, &rl, "select value from mtag_data where tag = %lld and offset = %d;",
-		tag, offset);
+	mem_select(mem_mtag_data, "value", NULL, &save_rl, &rl,
+		   "tag = %lld and offset = %d", tag, offset);
 	return rl;
 }
 
@@ -78,10 +78,10 @@ void insert_mtag_data(sval_t sval, struct range_list *rl)
 
 	rl = clone_rl_permanent(rl);
 
-	mem_sql(NULL, NULL, "delete from mtag_data where tag = %lld and offset = %d and type = %d",
-		tag, offset, DATA_VALUE);
-	mem_sql(NULL, NULL, "insert into mtag_data values (%lld, %d, %d, '%lu');",
-		tag, offset, DATA_VALUE, (unsigned long)rl);
+	mem_delete(mem_mtag_data, "tag = %lld and offset = %d and type = %d",
+		   tag, offset, DATA_VALUE);
+	mem_insert(mem_mtag_data, "%lld %d %d %lu",
+		   tag, offset, DATA_VALUE, (unsigned long)rl);
 }
 
 void update_mtag_data(struct expression *expr)
@@ -147,8 +147,8 @@ static int save_mtag_data(void *_unused, int argc, char **argv, char **azColName
 
 static void match_end_file(struct symbol_list *sym_list)
 {
-	mem_sql(&save_mtag_data, NULL, "select * from mtag_data where type = %d;",
-		DATA_VALUE);
+	mem_select(mem_mtag_data, "*", NULL, &save_mtag_data, NULL,
+		   "type = %d", DATA_VALUE);
 }
 
 struct db_info {
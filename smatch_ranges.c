@@ -1728,6 +1728,7 @@ void free_data_info_allocs(void)
 
 	free_all_rl();
 	clear_math_cache();
+	clear_const_estate_cache();
 
 	desc->blobs = NULL;
 	desc->allocations = 0;
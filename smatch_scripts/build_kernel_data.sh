@@ -37,11 +37,11 @@ fi
 
 $SCRIPT_DIR/test_kernel.sh --call-tree --info --param-mapper --spammy --data=$DATA_DIR
 
-for i in $SCRIPT_DIR/gen_* ; do
-	$i smatch_warns.txt -p=kernel
-done
+$SCRIPT_DIR/../gen_smatch_data --data=$DATA_DIR -p=kernel smatch_warns.txt
+$SCRIPT_DIR/gen_trinity.sh
 
 mv ${PROJECT}.* $DATA_DIR
+$CMD --data=$DATA_DIR --compile-data
 
 $DATA_DIR/db/create_db.sh -p=kernel smatch_warns.txt
 
@@ -8,6 +8,15 @@ if [ "$old" = "" ] ; then
     exit 1
 fi
 
+#
+# warn_baseline does the same thing in one pass and it also accepts
+# a baseline saved with "warn_baseline --save" as the old file.
+#
+SCRIPT_DIR=$(dirname $0)
+if [ -x $SCRIPT_DIR/../warn_baseline ] ; then
+    exec $SCRIPT_DIR/../warn_baseline $new $old
+fi
+
 #
 # If the $old and $new are very similar then we can 
 # filter out a lot of bug just by doing a diff.
@@ -0,0 +1,31 @@
+#!/bin/bash
+
+#
+# Add up the reports written by "smatch --db-profile=<file>" from many
+# runs and print the query shapes which took the most time.  The flags
+# column is S for a table scan, T for a temp b-tree sort and - if the
+# query uses an index for everything.
+#
+
+file=$1
+
+if [ "$file" = "" ] ; then
+    echo "usage:  $0 <db profile file> [nr of shapes]"
+    exit 1
+fi
+
+lines=${2:-30}
+
+awk -F'\t' '
+{
+    usec[$5] += $1
+    count[$5] += $2
+    rows[$5] += $3
+    flags[$5] = $4
+    plan[$5] = $6
+}
+END {
+    for (shape in usec)
+        printf "%d\t%d\t%d\t%s\t%s\t%s\n", usec[shape], count[shape], rows[shape], flags[shape], shape, plan[shape]
+}' $file | sort -t '	' -k 1,1 -rn | head -n $lines | \
+awk -F'\t' '{ printf "%8.3fs %8d calls %9d rows  %-2s %s\n          %s\n", $1 / 1000000, $2, $3, $4, $5, $6 }'
@@ -620,6 +620,11 @@ static void match_states_stree(struct stree **one, struct stree **two)
 	for (;;) {
 		if (!one_iter.sm && !two_iter.sm)
 			break;
+		if (avl_iter_shared_owner(&one_iter, &two_iter)) {
+			avl_iter_next_owner(&one_iter);
+			avl_iter_next_owner(&two_iter);
+			continue;
+		}
 		if (cmp_tracker(one_iter.sm, two_iter.sm) < 0) {
 			__set_fake_cur_stree_fast(*two);
 			tmp_state = __client_unmatched_state_function(one_iter.sm);
@@ -756,6 +761,16 @@ static void __merge_stree(struct stree **to, struct stree *stree, int add_pool)
 	for (;;) {
 		if (!one_iter.sm || !two_iter.sm)
 			break;
+		if (avl_iter_shared_owner(&one_iter, &two_iter)) {
+			/* nothing to merge, the results can share the subtree */
+			avl_insert_owner(&results, &one_iter);
+			FOR_EACH_MY_SM(one_iter.sm->owner, implied_one, tmp_sm) {
+				add_possible_sm(tmp_sm, tmp_sm);
+			} END_FOR_EACH_SM(tmp_sm);
+			avl_iter_next_owner(&one_iter);
+			avl_iter_next_owner(&two_iter);
+			continue;
+		}
 		if (cmp_tracker(one_iter.sm, two_iter.sm) < 0) {
 			sm_msg("error:  Internal smatch error.");
 			avl_iter_next(&one_iter);
@@ -887,6 +902,11 @@ void filter_stree(struct stree **stree, struct stree *filter)
 	for (;;) {
 		if (!one_iter.sm && !two_iter.sm)
 			break;
+		if (avl_iter_shared_owner(&one_iter, &two_iter)) {
+			avl_iter_next_owner(&one_iter);
+			avl_iter_next_owner(&two_iter);
+			continue;
+		}
 		if (cmp_tracker(one_iter.sm, two_iter.sm) < 0) {
 			avl_insert(&results, one_iter.sm);
 			avl_iter_next(&one_iter);
@@ -442,9 +442,8 @@ struct stree *get_all_states_from_stree(int owner, struct stree *source)
 	struct stree *ret = NULL;
 	struct sm_state *tmp;
 
-	FOR_EACH_SM(source, tmp) {
-		if (tmp->owner == owner)
-			avl_insert(&ret, tmp);
+	FOR_EACH_MY_SM(owner, source, tmp) {
+		avl_insert(&ret, tmp);
 	} END_FOR_EACH_SM(tmp);
 
 	return ret;
@@ -138,8 +138,8 @@ static void match_string(struct expression *expr)
 	if (!get_string_mtag(expr, &tag))
 		return;
 
-	cache_sql(NULL, NULL, "insert into mtag_data values (%lld, %d, %d, '%q');",
-		  tag, 0, STRING_VALUE, escape_newlines(expr->string->data));
+	mem_insert(cache_mtag_data, "%lld %d %d %s",
+		   tag, 0, STRING_VALUE, escape_newlines(expr->string->data));
 }
 
 void register_strings(int id)
@@ -545,7 +545,8 @@ void register_struct_assignment(int id)
 
 	add_function_hook("sscanf", &match_sscanf, NULL);
 
-	add_hook(&unop_expr, OP_HOOK);
+	add_op_hook(&unop_expr, OP_HOOK, SPECIAL_INCREMENT);
+	add_op_hook(&unop_expr, OP_HOOK, SPECIAL_DECREMENT);
 	register_clears_param();
 	select_return_states_hook(PARAM_CLEARED, &db_param_cleared);
 
@@ -2,6 +2,7 @@
 #include "allocate.h"
 #include "linearize.h"
 #include "storage.h"
+#include "token.h"
 
 __DECLARE_ALLOCATOR(struct ptr_list, ptrlist);
 
@@ -59,4 +60,8 @@ void report_stats(void)
 {
 	if (fmem_report)
 		show_allocation_stats();
+	if (dbg_ident)
+		show_identifier_stats();
+	if (dbg_include)
+		show_include_stats();
 }
@@ -0,0 +1,94 @@
+/*
+ * Tokenizer microbenchmark: tokenize the given files over and over,
+ * without preprocessing them, and report the token rate.
+ *
+ *	./test-tokenize [-n passes] file...
+ *
+ * The numbers quoted for the tokenizer changes come from about 900
+ * system headers, 5 passes, best of seven runs:
+ *
+ *	find /usr/include -name '*.h' | sort | head -900 > corpus.txt
+ *	./test-tokenize -n 5 $(cat corpus.txt)
+ *
+ * Use the same corpus file for the before and after runs.  Every pass
+ * keeps its tokens, so memory grows with passes * corpus size; with 30
+ * passes the runs spread by 20% and more.
+ *
+ * Copyright (C) 2020 Dan Carpenter.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include "token.h"
+#include "symbol.h"
+
+static unsigned long tokenize_file(const char *name)
+{
+	struct token *token;
+	unsigned long nr = 0;
+	int fd;
+
+	fd = open(name, O_RDONLY);
+	if (fd < 0)
+		die("cannot open %s", name);
+	token = tokenize(name, fd, NULL, NULL);
+	close(fd);
+	for (token = token->next; token_type(token) != TOKEN_STREAMEND; token = token->next)
+		nr++;
+	return nr;
+}
+
+int main(int argc, char **argv)
+{
+	struct string_list *filelist = NULL;
+	unsigned long tokens = 0;
+	struct timespec start, end;
+	int passes = 1, files = 0, i;
+	double secs;
+	char *file;
+
+	if (argc > 2 && !strcmp(argv[1], "-n")) {
+		passes = atoi(argv[2]);
+		argv[2] = argv[0];
+		argv += 2;
+		argc -= 2;
+	}
+	sparse_initialize(argc, argv, &filelist);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < passes; i++) {
+		FOR_EACH_PTR_NOTAG(filelist, file) {
+			tokens += tokenize_file(file);
+			files += !i;
+		} END_FOR_EACH_PTR_NOTAG(file);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	secs = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+	printf("%d files, %lu tokens per pass, %d passes: %.3fs, %.2f Mtokens/s\n",
+		files, passes ? tokens / passes : 0, passes, secs,
+		secs > 0 ? tokens / secs / 1e6 : 0);
+	return 0;
+}
@@ -67,6 +67,7 @@ extern struct stream *input_streams;
 extern unsigned int tabstop;
 extern int no_lineno;
 extern int *hash_stream(const char *name);
+extern int find_stream(const char *name);
 
 struct ident {
 	struct ident *next;	/* Hash chain of identifiers */
@@ -74,7 +75,8 @@ struct ident {
 	unsigned char len;	/* Length of identifier name */
 	unsigned char tainted:1,
 	              reserved:1,
-		      keyword:1;
+		      keyword:1,
+		      seen:1;		/* Expanded as a macro or used in an expression */
 	char name[];		/* Actual identifier */
 };
 
@@ -217,6 +219,7 @@ extern struct token eof_token_entry;
 
 extern int init_stream(const char *, int fd, const char **next_path);
 extern const char *stream_name(int stream);
+extern unsigned int hash_path(const char *name);
 extern struct ident *hash_ident(struct ident *);
 extern struct ident *built_in_ident(const char *);
 extern struct token *built_in_token(int, struct ident *);
@@ -229,6 +232,7 @@ extern struct token * tokenize(const char *, int, struct token *, const char **n
 extern struct token * tokenize_buffer(void *, unsigned long, struct token **);
 
 extern void show_identifier_stats(void);
+extern void show_include_stats(void);
 extern void init_include_path(void);
 extern struct token *preprocess(struct token *);
 
@@ -31,6 +31,9 @@
 #include <ctype.h>
 #include <unistd.h>
 #include <stdint.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "lib.h"
 #include "allocate.h"
@@ -282,23 +285,131 @@ const char *quote_token(const struct token *token)
 	}
 }
 
-#define HASHED_INPUT_BITS (6)
-#define HASHED_INPUT (1 << HASHED_INPUT_BITS)
-#define HASH_PRIME 0x9e370001UL
+/*
+ * Streams are looked up by file name every time something is #included so
+ * the table is keyed on the (lexically canonical) path and grows with the
+ * number of files.  Each entry heads the list of streams for that one file,
+ * most recent first, so already_tokenized() only looks at the streams which
+ * can actually match.
+ */
+#define STREAM_HASH_BITS (10)
 
-static int input_stream_hashes[HASHED_INPUT] = { [0 ... HASHED_INPUT-1] = -1 };
+struct stream_name {
+	const char *name;
+	unsigned int hash;
+	int stream;
+	struct stream_name *next;
+};
 
-int *hash_stream(const char *name)
+static struct stream_name **stream_names;
+static unsigned int stream_names_size, stream_names_nr;
+
+/*
+ * "a//b.h", "a/./b.h" and "./a/b.h" are all the same file.  We don't try
+ * to do anything about ".." or symlinks since that would mean hitting the
+ * file system.
+ */
+static const char *canonical_path(const char *name, char *buf, int size)
+{
+	const char *p = name;
+	int len = 0;
+
+	if (!strstr(name, "//") && !strstr(name, "/./") && strncmp(name, "./", 2) != 0)
+		return name;
+
+	while (p[0] == '.' && p[1] == '/')
+		p += 2;
+	while (*p && len < size - 1) {
+		if (p[0] == '/' && p[1] == '/') {
+			p++;
+			continue;
+		}
+		if (p[0] == '/' && p[1] == '.' && p[2] == '/') {
+			p += 2;
+			continue;
+		}
+		buf[len++] = *p++;
+	}
+	if (*p)
+		return name;
+	buf[len] = '\0';
+	return buf;
+}
+
+unsigned int hash_path(const char *name)
 {
-	uint32_t hash = 0;
+	uint32_t hash = 0x811c9dc5;
 	unsigned char c;
 
 	while ((c = *name++) != 0)
-		hash = (hash + (c << 4) + (c >> 4)) * 11;
+		hash = (hash ^ c) * 0x01000193;
+	return hash ^ (hash >> 15);
+}
 
-	hash *= HASH_PRIME;
-	hash >>= 32 - HASHED_INPUT_BITS;
-	return input_stream_hashes + hash;
+static void grow_stream_names(void)
+{
+	struct stream_name **old = stream_names;
+	unsigned int old_size = stream_names_size;
+	struct stream_name *sn, *next;
+	unsigned int i;
+
+	stream_names_size = old_size ? old_size * 2 : 1 << STREAM_HASH_BITS;
+	stream_names = calloc(stream_names_size, sizeof(*stream_names));
+	if (!stream_names)
+		die("Unable to allocate the stream hash table");
+
+	for (i = 0; i < old_size; i++) {
+		for (sn = old[i]; sn; sn = next) {
+			next = sn->next;
+			sn->next = stream_names[sn->hash & (stream_names_size - 1)];
+			stream_names[sn->hash & (stream_names_size - 1)] = sn;
+		}
+	}
+	free(old);
+}
+
+static struct stream_name *lookup_stream_name(const char *name, int create)
+{
+	char buf[PATH_MAX];
+	struct stream_name *sn, **bucket;
+	unsigned int hash;
+
+	name = canonical_path(name, buf, sizeof(buf));
+	hash = hash_path(name);
+
+	if (stream_names) {
+		for (sn = stream_names[hash & (stream_names_size - 1)]; sn; sn = sn->next) {
+			if (sn->hash == hash && strcmp(sn->name, name) == 0)
+				return sn;
+		}
+	}
+	if (!create)
+		return NULL;
+
+	if (stream_names_nr >= stream_names_size)
+		grow_stream_names();
+	stream_names_nr++;
+
+	sn = malloc(sizeof(*sn));
+	sn->name = strdup(name);
+	sn->hash = hash;
+	sn->stream = -1;
+	bucket = &stream_names[hash & (stream_names_size - 1)];
+	sn->next = *bucket;
+	*bucket = sn;
+	return sn;
+}
+
+int *hash_stream(const char *name)
+{
+	return &lookup_stream_name(name, 1)->stream;
+}
+
+int find_stream(const char *name)
+{
+	struct stream_name *sn = lookup_stream_name(name, 0);
+
+	return sn ? sn->stream : -1;
 }
 
 int init_stream(const char *name, int fd, const char **next_path)
@@ -442,6 +553,71 @@ static inline int nextchar(stream_t *stream)
 	return nextchar_slow(stream);
 }
 
+/*
+ * The inner loops below (whitespace, comments, strings and identifiers)
+ * consume runs of ordinary characters straight out of the buffer instead
+ * of going through nextchar() one byte at a time.  They stop at the end of
+ * the buffer and at anything nextchar_slow() has to look at, so line
+ * splicing and '\r' handling still happen in one place.
+ */
+static inline void skip_blanks(stream_t *stream)
+{
+	const unsigned char *buf = stream->buffer;
+	int offset = stream->offset;
+	int size = stream->size;
+	int pos = stream->pos;
+
+	while (offset < size) {
+		switch (buf[offset]) {
+		case ' ':
+		case '\v':
+		case '\f':
+			pos++;
+			break;
+		case '\t':
+			pos += tabstop - pos % tabstop;
+			break;
+		case '\n':
+			stream->line++;
+			stream->newline = 1;
+			pos = 0;
+			break;
+		default:
+			goto out;
+		}
+		offset++;
+	}
+out:
+	stream->offset = offset;
+	stream->pos = pos;
+}
+
+static inline void skip_comment_body(stream_t *stream)
+{
+	const unsigned char *buf = stream->buffer;
+	int offset = stream->offset;
+	int size = stream->size;
+	int pos = stream->pos;
+	int c;
+
+	for (; offset < size; offset++) {
+		c = buf[offset];
+		if (c == '*' || c == '\\' || c == '\r')
+			break;
+		if (c == '\n') {
+			stream->line++;
+			stream->newline = 1;
+			pos = 0;
+		} else if (c == '\t') {
+			pos += tabstop - pos % tabstop;
+		} else {
+			pos++;
+		}
+	}
+	stream->offset = offset;
+	stream->pos = pos;
+}
+
 struct token eof_token_entry;
 
 static struct token *mark_eof(stream_t *stream)
@@ -585,6 +761,28 @@ static int get_one_number(int c, int next, stream_t *stream)
 	return next;
 }
 
+/* copy the plain characters of a string literal up to the next special one */
+static inline int copy_string_run(stream_t *stream, char *buffer, int len, char delim)
+{
+	const unsigned char *buf = stream->buffer;
+	int offset = stream->offset;
+	int size = stream->size;
+	int start = offset;
+	int c;
+
+	for (; offset < size; offset++) {
+		c = buf[offset];
+		if (c == delim || c == '\\' || c == '\n' || c == '\r' || c == '\t')
+			break;
+		if (len < MAX_STRING)
+			buffer[len] = c;
+		len++;
+	}
+	stream->pos += offset - start;
+	stream->offset = offset;
+	return len;
+}
+
 static int eat_string(int next, stream_t *stream, enum token_type type)
 {
 	static char buffer[MAX_STRING];
@@ -620,6 +818,8 @@ static int eat_string(int next, stream_t *stream, enum token_type type)
 			escape = 0;
 			want_hex = next == 'x';
 		}
+		if (!escape && !want_hex)
+			len = copy_string_run(stream, buffer, len, delim);
 	}
 	if (want_hex)
 		warning(stream_pos(stream),
@@ -679,6 +879,8 @@ static int drop_stream_comment(stream_t *stream)
 			warning(stream_pos(stream), "End of file in the middle of a comment");
 			return curr;
 		}
+		if (curr != '*')
+			skip_comment_body(stream);
 		next = nextchar(stream);
 		if (curr == '*' && next == '/')
 			break;
@@ -800,20 +1002,74 @@ static int get_one_special(int c, stream_t *stream)
 	return next;
 }
 
+/*
+ * The identifier table starts out with 8k buckets and doubles whenever the
+ * average chain gets longer than two, so lookups stay O(1) even for big
+ * kernel translation units.  ident_hash_end() returns the full 32 bit hash;
+ * the bucket is picked with the current mask.
+ */
 #define IDENT_HASH_BITS (13)
-#define IDENT_HASH_SIZE (1<<IDENT_HASH_BITS)
-#define IDENT_HASH_MASK (IDENT_HASH_SIZE-1)
+#define IDENT_HASH_MAX_LOAD (2)
 
-#define ident_hash_init(c)		(c)
-#define ident_hash_add(oldhash,c)	((oldhash)*11 + (c))
-#define ident_hash_end(hash)		((((hash) >> IDENT_HASH_BITS) + (hash)) & IDENT_HASH_MASK)
+#define ident_hash_init(c)		((0x811c9dc5U ^ (c)) * 0x01000193U)
+#define ident_hash_add(oldhash,c)	(((unsigned int)(oldhash) ^ (c)) * 0x01000193U)
+#define ident_hash_end(hash)		((unsigned int)(hash) ^ ((unsigned int)(hash) >> 15))
 
-static struct ident *hash_table[IDENT_HASH_SIZE];
+static struct ident **hash_table;
+static unsigned int ident_hash_size, ident_hash_mask;
 static int ident_hit, ident_miss, idents;
+static unsigned long ident_probes;
+
+static unsigned long hash_name(const char *name, int len);
+
+static void alloc_hash_table(unsigned int size)
+{
+	hash_table = calloc(size, sizeof(*hash_table));
+	if (!hash_table)
+		die("Unable to allocate the identifier hash table");
+	ident_hash_size = size;
+	ident_hash_mask = size - 1;
+}
+
+static void grow_hash_table(void)
+{
+	struct ident **old = hash_table;
+	unsigned int old_size = ident_hash_size;
+	struct ident **tail;
+	struct ident *ident, *next;
+	unsigned int i;
+
+	alloc_hash_table(old_size * 2);
+
+	/*
+	 * Entries with the same name always share a chain.  Appending keeps
+	 * them in the same order so lookups return the same ident as before.
+	 */
+	for (i = 0; i < old_size; i++) {
+		for (ident = old[i]; ident; ident = next) {
+			next = ident->next;
+			tail = &hash_table[hash_name(ident->name, ident->len) & ident_hash_mask];
+			while (*tail)
+				tail = &(*tail)->next;
+			ident->next = NULL;
+			*tail = ident;
+		}
+	}
+	free(old);
+}
+
+static struct ident **hash_bucket(unsigned long hash)
+{
+	if (!hash_table)
+		alloc_hash_table(1 << IDENT_HASH_BITS);
+	else if (idents > ident_hash_size * IDENT_HASH_MAX_LOAD)
+		grow_hash_table();
+	return &hash_table[hash & ident_hash_mask];
+}
 
 void show_identifier_stats(void)
 {
-	int i;
+	unsigned int i, used = 0, longest = 0;
 	int distribution[100];
 
 	fprintf(stderr, "identifiers: %d hits, %d misses\n",
@@ -822,7 +1078,7 @@ void show_identifier_stats(void)
 	for (i = 0; i < 100; i++)
 		distribution[i] = 0;
 
-	for (i = 0; i < IDENT_HASH_SIZE; i++) {
+	for (i = 0; i < ident_hash_size; i++) {
 		struct ident * ident = hash_table[i];
 		int count = 0;
 
@@ -830,11 +1086,22 @@ void show_identifier_stats(void)
 			count++;
 			ident = ident->next;
 		}
+		if (count)
+			used++;
+		if (count > longest)
+			longest = count;
 		if (count > 99)
 			count = 99;
 		distribution[count]++;
 	}
 
+	fprintf(stderr, "identifiers: %d in %u buckets, %.1f%% used, longest chain %u\n",
+		idents, ident_hash_size,
+		100.0 * used / (ident_hash_size ? : 1), longest);
+	fprintf(stderr, "identifiers: %.2f average chain, %.2f compares per lookup\n",
+		(double)idents / (used ? : 1),
+		(double)ident_probes / ((ident_hit + ident_miss) ? : 1));
+
 	for (i = 0; i < 100; i++) {
 		if (distribution[i])
 			fprintf(stderr, "%2d: %d buckets\n", i, distribution[i]);
@@ -853,9 +1120,12 @@ static struct ident *alloc_ident(const char *name, int len)
 
 static struct ident * insert_hash(struct ident *ident, unsigned long hash)
 {
-	ident->next = hash_table[hash];
-	hash_table[hash] = ident;
+	struct ident **bucket = hash_bucket(hash);
+
+	ident->next = *bucket;
+	*bucket = ident;
 	ident_miss++;
+	idents++;
 	return ident;
 }
 
@@ -864,8 +1134,9 @@ static struct ident *create_hashed_ident(const char *name, int len, unsigned lon
 	struct ident *ident;
 	struct ident **p;
 
-	p = &hash_table[hash];
+	p = hash_bucket(hash);
 	while ((ident = *p) != NULL) {
+		ident_probes++;
 		if (ident->len == (unsigned char) len) {
 			if (strncmp(name, ident->name, len) != 0)
 				goto next;
@@ -927,10 +1198,25 @@ static int get_one_identifier(int c, stream_t *stream)
 	unsigned long hash;
 	char buf[256];
 	int len = 1;
+	int offset;
 	int next;
 
 	hash = ident_hash_init(c);
 	buf[0] = c;
+
+	/* fast path for the part of the name which is in the buffer */
+	offset = stream->offset;
+	while (offset < stream->size && len < sizeof(buf)) {
+		next = stream->buffer[offset];
+		if (!(cclass[next + 1] & (Letter | Digit)))
+			break;
+		hash = ident_hash_add(hash, next);
+		buf[len++] = next;
+		offset++;
+	}
+	stream->pos += offset - stream->offset;
+	stream->offset = offset;
+
 	for (;;) {
 		next = nextchar(stream);
 		if (!(cclass[next + 1] & (Letter | Digit)))
@@ -1008,6 +1294,7 @@ static struct token *tokenize_stream(stream_t *stream)
 			continue;
 		}
 		stream->whitespace = 1;
+		skip_blanks(stream);
 		c = nextchar(stream);
 	}
 	return mark_eof(stream);
@@ -1023,11 +1310,33 @@ struct token * tokenize_buffer(void *buffer, unsigned long size, struct token **
 	return begin;
 }
 
+/*
+ * Regular files are mapped and tokenized in one go.  Anything else (pipes,
+ * stdin, empty files) goes through the read() buffer.
+ */
+static unsigned char *map_file(int fd, unsigned int *size)
+{
+	struct stat st;
+	void *map;
+
+	if (fd < 0 || fstat(fd, &st) < 0 || !S_ISREG(st.st_mode))
+		return NULL;
+	if (st.st_size <= 0 || st.st_size > INT_MAX)
+		return NULL;
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (map == MAP_FAILED)
+		return NULL;
+	*size = st.st_size;
+	return map;
+}
+
 struct token * tokenize(const char *name, int fd, struct token *endtoken, const char **next_path)
 {
 	struct token *begin, *end;
 	stream_t stream;
 	unsigned char buffer[BUFSIZE];
+	unsigned char *map;
+	unsigned int map_size;
 	int idx;
 
 	idx = init_stream(name, fd, next_path);
@@ -1036,8 +1345,14 @@ struct token * tokenize(const char *name, int fd, struct token *endtoken, const
 		return endtoken;
 	}
 
-	begin = setup_stream(&stream, idx, fd, buffer, 0);
+	map = map_file(fd, &map_size);
+	if (map)
+		begin = setup_stream(&stream, idx, -1, map, map_size);
+	else
+		begin = setup_stream(&stream, idx, fd, buffer, 0);
 	end = tokenize_stream(&stream);
+	if (map)
+		munmap(map, map_size);
 	if (endtoken)
 		end->next = endtoken;
 	return begin;
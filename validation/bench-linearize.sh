@@ -0,0 +1,69 @@
+#!/bin/sh
+#
+# Time test-linearize on generated functions which are much larger than
+# anything in the test suite, the kind of function where the symbol
+# simplification and CSE used to go quadratic:
+#
+#	straight: one block storing and loading the same locals n times
+#	diamonds: n if/else diamonds assigning two locals
+#	chain:    n blocks in a row, each one dominating the next
+#
+#	./bench-linearize.sh [n]
+#
+# Run it from the validation directory, before and after a change.
+
+n=${1:-5000}
+linearize=${LINEARIZE:-../test-linearize}
+tmp=${TMPDIR:-/tmp}/bench-linearize.$$
+
+mkdir -p $tmp || exit 1
+trap "rm -rf $tmp" EXIT
+
+{
+	echo "int straight(int x)"
+	echo "{"
+	echo "	int a = x, b = 0;"
+	i=0
+	while [ $i -lt $n ] ; do
+		echo "	a = a + b; b = a ^ $i;"
+		i=$((i + 1))
+	done
+	echo "	return a + b;"
+	echo "}"
+} > $tmp/straight.c
+
+{
+	echo "extern int g(int);"
+	echo "int diamonds(int x)"
+	echo "{"
+	echo "	int a = 0, b = 1;"
+	i=0
+	while [ $i -lt $n ] ; do
+		echo "	if (g($i)) { a = a + b; b = x; } else a = b;"
+		i=$((i + 1))
+	done
+	echo "	return a + b;"
+	echo "}"
+} > $tmp/diamonds.c
+
+{
+	echo "extern int g(int);"
+	echo "int chain(int x)"
+	echo "{"
+	echo "	int a = x;"
+	i=0
+	while [ $i -lt $n ] ; do
+		echo "	if (g(a + $i)) goto L$i; L$i:"
+		i=$((i + 1))
+	done
+	echo "	return a;"
+	echo "}"
+} > $tmp/chain.c
+
+for f in straight diamonds chain ; do
+	start=$(date +%s%N)
+	$linearize -Wno-decl $tmp/$f.c > /dev/null || exit 1
+	end=$(date +%s%N)
+	printf "%-10s n=%-6d %4d.%03ds\n" $f $n $(((end - start) / 1000000000)) \
+		$((((end - start) / 1000000) % 1000))
+done
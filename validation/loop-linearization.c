@@ -39,31 +39,25 @@ static int fdo(void)
 ffor:
 .L0:
 	<entry-point>
-	phisrc.32   %phi5(i) <- $0
+	phisrc.32   %phi3(i) <- $0
 	br          .L4
 
 .L4:
-	phi.32      %r1(i) <- %phi5(i), %phi6(i)
-	setlt.32    %r2 <- %r1(i), $10
-	cbr         %r2, .L1, .L3
+	phi.32      %r8(i) <- %phi3(i), %phi4(i)
+	setlt.32    %r2 <- %r8(i), $10
+	phisrc.32   %phi2(return) <- $1
+	cbr         %r2, .L1, .L7
 
 .L1:
-	call.32     %r4 <- p, %r1(i)
-	cbr         %r4, .L2, .L5
-
-.L5:
+	call.32     %r4 <- p, %r8(i)
 	phisrc.32   %phi1(return) <- $0
-	br          .L7
+	cbr         %r4, .L2, .L7
 
 .L2:
-	add.32      %r7 <- %r1(i), $1
-	phisrc.32   %phi6(i) <- %r7
+	add.32      %r7 <- %r8(i), $1
+	phisrc.32   %phi4(i) <- %r7
 	br          .L4
 
-.L3:
-	phisrc.32   %phi2(return) <- $1
-	br          .L7
-
 .L7:
 	phi.32      %r5 <- %phi1(return), %phi2(return)
 	ret.32      %r5
@@ -72,64 +66,52 @@ ffor:
 fwhile:
 .L8:
 	<entry-point>
-	phisrc.32   %phi11(i) <- $0
+	phisrc.32   %phi7(i) <- $0
 	br          .L12
 
 .L12:
-	phi.32      %r8(i) <- %phi11(i), %phi12(i)
-	setlt.32    %r9 <- %r8(i), $10
-	cbr         %r9, .L9, .L11
+	phi.32      %r16(i) <- %phi7(i), %phi8(i)
+	setlt.32    %r10 <- %r16(i), $10
+	phisrc.32   %phi6(return) <- $1
+	cbr         %r10, .L9, .L15
 
 .L9:
-	call.32     %r11 <- p, %r8(i)
-	cbr         %r11, .L14, .L13
-
-.L13:
-	phisrc.32   %phi7(return) <- $0
-	br          .L15
+	call.32     %r12 <- p, %r16(i)
+	phisrc.32   %phi5(return) <- $0
+	cbr         %r12, .L14, .L15
 
 .L14:
-	add.32      %r14 <- %r8(i), $1
-	phisrc.32   %phi12(i) <- %r14
+	add.32      %r15 <- %r16(i), $1
+	phisrc.32   %phi8(i) <- %r15
 	br          .L12
 
-.L11:
-	phisrc.32   %phi8(return) <- $1
-	br          .L15
-
 .L15:
-	phi.32      %r12 <- %phi7(return), %phi8(return)
-	ret.32      %r12
+	phi.32      %r13 <- %phi5(return), %phi6(return)
+	ret.32      %r13
 
 
 fdo:
 .L16:
 	<entry-point>
-	phisrc.32   %phi16(i) <- $0
+	phisrc.32   %phi11(i) <- $0
 	br          .L17
 
 .L17:
-	phi.32      %r15(i) <- %phi16(i), %phi17(i)
-	call.32     %r16 <- p, %r15(i)
-	cbr         %r16, .L18, .L20
-
-.L20:
-	phisrc.32   %phi13(return) <- $0
-	br          .L22
+	phi.32      %r23(i) <- %phi11(i), %phi12(i)
+	call.32     %r18 <- p, %r23(i)
+	phisrc.32   %phi9(return) <- $0
+	cbr         %r18, .L18, .L22
 
 .L18:
-	add.32      %r19 <- %r15(i), $1
-	setlt.32    %r20 <- %r15(i), $10
-	phisrc.32   %phi17(i) <- %r19
-	cbr         %r20, .L17, .L19
-
-.L19:
-	phisrc.32   %phi14(return) <- $1
-	br          .L22
+	add.32      %r21 <- %r23(i), $1
+	setlt.32    %r22 <- %r23(i), $10
+	phisrc.32   %phi12(i) <- %r21
+	phisrc.32   %phi10(return) <- $1
+	cbr         %r22, .L17, .L22
 
 .L22:
-	phi.32      %r17 <- %phi13(return), %phi14(return)
-	ret.32      %r17
+	phi.32      %r19 <- %phi9(return), %phi10(return)
+	ret.32      %r19
 
 
  * check-output-end
@@ -0,0 +1,21 @@
+#!/bin/bash
+
+# Fill type_value from the function_type_value rows which "smatch --info"
+# prints for a file and show the result.  The file is checked twice, with
+# TU set to 1 and to 2, so it can define a struct differently in each
+# "translation unit".
+
+db=merge_type_ranges.sqlite
+
+rm -f $db
+cat ../smatch_data/db/function_type_value.schema \
+    ../smatch_data/db/function_type_size.schema \
+    ../smatch_data/db/type_size.schema \
+    ../smatch_data/db/type_value.schema | sqlite3 $db
+for tu in 1 2 ; do
+    ../smatch --info -DTU=$tu $*
+done | grep -o 'insert into function_type_value .*' | sqlite3 $db
+../smatch --db-file=$db --merge-type-ranges
+sqlite3 $db "select * from type_value order by type;"
+
+rm $db
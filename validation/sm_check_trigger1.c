@@ -0,0 +1,30 @@
+#define offsetof(type, member) ((unsigned long)&((type *)0)->member)
+#define container_of(ptr, type, member) \
+	((type *)((char *)(ptr) - offsetof(type, member)))
+
+struct list_head {
+	struct list_head *next;
+};
+
+struct foo {
+	int x;
+	struct list_head list;
+};
+
+int get_x(struct list_head *p)
+{
+	struct foo *foo;
+
+	foo = container_of(p, struct foo, list);
+	if (!foo)
+		return -1;
+	return foo->x;
+}
+/*
+ * check-name: smatch check trigger from a macro
+ * check-command: smatch -p=kernel sm_check_trigger1.c
+ *
+ * check-output-start
+sm_check_trigger1.c:19 get_x() warn: can 'foo' even be NULL?
+ * check-output-end
+ */
@@ -0,0 +1,21 @@
+struct device;
+
+int dma_mapping_error(struct device *dev, unsigned long addr);
+
+int map_one(struct device *dev, unsigned long addr)
+{
+	int ret;
+
+	ret = addr ? 0 : 1;
+	if (ret)
+		return ret;
+	return 0;
+}
+/*
+ * check-name: smatch check trigger from a prototype
+ * check-command: smatch -p=kernel --debug=check_dma_mapping_error sm_check_trigger2.c
+ *
+ * check-output-start
+check_dma_mapping_error: inactive
+ * check-output-end
+ */
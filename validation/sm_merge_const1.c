@@ -0,0 +1,35 @@
+#include "check_debug.h"
+
+int a, b, c;
+void func(int x)
+{
+	if (x) {
+		a = 1;
+		b = 1;
+	} else {
+		a = 2;
+		b = 2;
+	}
+	c = a;
+	__smatch_dump_related();
+	c = 42;
+	__smatch_dump_related();
+	__smatch_implied(a);
+	__smatch_implied(b);
+	__smatch_hard_max(a);
+	__smatch_hard_max(b);
+}
+/*
+ * check-name: smatch: merge constant estates #1
+ * check-command: smatch -I.. sm_merge_const1.c
+ *
+ * check-output-start
+sm_merge_const1.c:14 func() a: c a 
+sm_merge_const1.c:14 func() c: c a 
+sm_merge_const1.c:16 func() a: a 
+sm_merge_const1.c:17 func() implied: a = '1-2'
+sm_merge_const1.c:18 func() implied: b = '1-2'
+sm_merge_const1.c:19 func() hard max: a = 2
+sm_merge_const1.c:20 func() hard max: b = 2
+ * check-output-end
+ */
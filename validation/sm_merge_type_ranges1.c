@@ -0,0 +1,39 @@
+#if TU == 1
+struct foo {
+	long long x;
+	long long y;
+};
+
+void one(struct foo *p)
+{
+	p->x = -1;
+	p->y = -20;
+}
+#else
+struct foo {
+	unsigned long long x;
+	long long y;
+};
+
+void two(struct foo *p)
+{
+	p->x = 18446744073709551615ULL;
+	p->y = 10;
+}
+
+void three(struct foo *p)
+{
+	p->x = 5;
+	p->y = -5;
+}
+#endif
+
+/*
+ * check-name: smatch: merge type ranges #1
+ * check-command: validation/merge_type_ranges_test.sh sm_merge_type_ranges1.c
+ *
+ * check-output-start
+(struct foo)->x|(-1),5,u64max
+(struct foo)->y|(-20),(-5),10
+ * check-output-end
+ */
@@ -5,5 +5,5 @@ rm -f smatch_db.sqlite
 ./build_smatch_db.sh $*
 ../smatch $*
 
-rm smatch_db.sqlite
+rm -f smatch_db.sqlite
 
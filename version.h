@@ -0,0 +1 @@
+#define SPARSE_VERSION "0.5.1"
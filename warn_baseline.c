@@ -0,0 +1,279 @@
+/*
+ * Copyright (C) 2020 Dan Carpenter.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see http://www.gnu.org/copyleft/gpl.txt
+ */
+
+/*
+ * Find the new warnings in a smatch_warns.txt compared to an older run.
+ *
+ * warn_baseline --save <smatch_warns.txt> <baseline>
+ * warn_baseline <new smatch_warns.txt> <old smatch_warns.txt or baseline>
+ *
+ * Line numbers change all the time so a warning is reduced to a key made
+ * of the file, the function and the message with any line numbers in it
+ * dropped.  The same message can be printed several times in a function,
+ * so the old run is loaded as a count per key and the new warnings are
+ * the ones which go past that count.  The new file is read once and
+ * nothing is sorted except when a baseline is saved.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#define BASELINE_HEADER "# warn_baseline 1\n"
+
+struct entry {
+	char *key;
+	unsigned int hash;
+	int count;
+	int seen;
+};
+
+static struct entry *table;
+static unsigned int table_size = 1 << 16;
+static unsigned int nr_entries;
+
+static void die(const char *fmt, const char *arg)
+{
+	fprintf(stderr, "warn_baseline: ");
+	fprintf(stderr, fmt, arg);
+	fprintf(stderr, "\n");
+	exit(1);
+}
+
+static void *xcalloc(size_t nmemb, size_t size)
+{
+	void *p = calloc(nmemb, size);
+
+	if (!p)
+		die("out of memory%s", "");
+	return p;
+}
+
+static unsigned int hash_key(const char *key)
+{
+	unsigned int hash = 2166136261u;
+
+	while (*key)
+		hash = (hash ^ (unsigned char)*key++) * 16777619u;
+	return hash;
+}
+
+static struct entry *find_slot(struct entry *tab, unsigned int size,
+			       const char *key, unsigned int hash)
+{
+	unsigned int i = hash & (size - 1);
+
+	while (tab[i].key) {
+		if (tab[i].hash == hash && strcmp(tab[i].key, key) == 0)
+			break;
+		i = (i + 1) & (size - 1);
+	}
+	return &tab[i];
+}
+
+static void grow_table(void)
+{
+	struct entry *old = table;
+	unsigned int i, old_size = table_size;
+
+	table_size *= 2;
+	table = xcalloc(table_size, sizeof(*table));
+	for (i = 0; i < old_size; i++) {
+		if (old[i].key)
+			*find_slot(table, table_size, old[i].key, old[i].hash) = old[i];
+	}
+	free(old);
+}
+
+static struct entry *lookup(const char *key)
+{
+	return find_slot(table, table_size, key, hash_key(key));
+}
+
+static void add_key(const char *key, int count)
+{
+	unsigned int hash = hash_key(key);
+	struct entry *e;
+
+	e = find_slot(table, table_size, key, hash);
+	if (!e->key) {
+		e->key = strdup(key);
+		if (!e->key)
+			die("out of memory%s", "");
+		e->hash = hash;
+		if (++nr_entries * 2 > table_size)
+			grow_table();
+		e = find_slot(table, table_size, key, hash);
+	}
+	e->count += count;
+}
+
+/*
+ * "file.c:123 func() warn: message (line 456)" becomes
+ * "file.c func() warn: message (line )".  Returns 0 for lines which
+ * are not warnings.
+ */
+static int warning_key(const char *line, char *key, int size)
+{
+	const char *p, *colon, *space;
+	int len = 0;
+
+	if (!strstr(line, "warn:") && !strstr(line, "error:") &&
+	    !strstr(line, "warning:"))
+		return 0;
+
+	space = strchr(line, ' ');
+	if (!space)
+		return 0;
+	colon = space;
+	while (colon > line && colon[-1] != ':')
+		colon--;
+	if (colon == line)
+		colon = space;
+	else
+		colon--;
+
+	for (p = line; p < colon && len < size - 1; p++)
+		key[len++] = *p;
+	for (p = space; *p && *p != '\n' && len < size - 1; p++) {
+		key[len++] = *p;
+		if (p - line >= 5 && strncmp(p - 4, "line ", 5) == 0) {
+			while (isdigit(p[1]))
+				p++;
+		}
+	}
+	key[len] = '\0';
+	return 1;
+}
+
+static int is_baseline(FILE *f)
+{
+	char buf[sizeof(BASELINE_HEADER)];
+	int ret;
+
+	ret = fgets(buf, sizeof(buf), f) && strcmp(buf, BASELINE_HEADER) == 0;
+	if (!ret)
+		rewind(f);
+	return ret;
+}
+
+static void load(const char *file)
+{
+	char *line = NULL, *tab;
+	char key[4096];
+	size_t alloc = 0;
+	FILE *f;
+
+	f = fopen(file, "r");
+	if (!f)
+		die("cannot open '%s'", file);
+
+	if (is_baseline(f)) {
+		while (getline(&line, &alloc, f) > 0) {
+			tab = strchr(line, '\t');
+			if (!tab)
+				continue;
+			tab[strcspn(tab, "\n")] = '\0';
+			add_key(tab + 1, atoi(line));
+		}
+	} else {
+		while (getline(&line, &alloc, f) > 0) {
+			if (warning_key(line, key, sizeof(key)))
+				add_key(key, 1);
+		}
+	}
+	free(line);
+	fclose(f);
+}
+
+static int cmp_entry(const void *a, const void *b)
+{
+	const struct entry *x = a, *y = b;
+
+	return strcmp(x->key, y->key);
+}
+
+static void save(const char *file)
+{
+	unsigned int i, n = 0;
+	FILE *f;
+
+	for (i = 0; i < table_size; i++) {
+		if (table[i].key)
+			table[n++] = table[i];
+	}
+	qsort(table, n, sizeof(*table), cmp_entry);
+
+	f = fopen(file, "w");
+	if (!f)
+		die("cannot write '%s'", file);
+	fputs(BASELINE_HEADER, f);
+	for (i = 0; i < n; i++)
+		fprintf(f, "%d\t%s\n", table[i].count, table[i].key);
+	if (fclose(f))
+		die("cannot write '%s'", file);
+}
+
+static void print_new(const char *file)
+{
+	char *line = NULL;
+	char key[4096];
+	size_t alloc = 0;
+	struct entry *e;
+	FILE *f;
+
+	f = fopen(file, "r");
+	if (!f)
+		die("cannot open '%s'", file);
+	while (getline(&line, &alloc, f) > 0) {
+		if (!warning_key(line, key, sizeof(key)))
+			continue;
+		e = lookup(key);
+		if (e->key && e->seen < e->count) {
+			e->seen++;
+			continue;
+		}
+		fputs(line, stdout);
+	}
+	free(line);
+	fclose(f);
+}
+
+static void usage(void)
+{
+	fprintf(stderr, "usage:  warn_baseline --save <smatch_warns.txt> <baseline>\n");
+	fprintf(stderr, "        warn_baseline <new file> <old file or baseline>\n");
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	table = xcalloc(table_size, sizeof(*table));
+
+	if (argc == 4 && strcmp(argv[1], "--save") == 0) {
+		load(argv[2]);
+		save(argv[3]);
+		return 0;
+	}
+	if (argc != 3 || argv[1][0] == '-')
+		usage();
+
+	load(argv[2]);
+	print_new(argv[1]);
+	return 0;
+}